@@ -4,10 +4,15 @@
 #include <stdio.h>
 
 #include <algorithm>
-#include <set>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <utility>
 
 #include "src/agent/agent.h"
 #include "src/communication/zmq_communicator.h"
+#include "src/message/key_value_codec.h"
 #include "src/message/message.pb.h"
 #include "src/util/logging.h"
 #include "src/util/network_util.h"
@@ -21,22 +26,29 @@ namespace rpscc {
 // Macro for getting the Agent's IP address
 DEFINE_string(net_interface, "",
               "Name of the net interface used by the node.");
-
-// This is a sorter for key list and value list sorted in the agent. During the
-// sorting, keys and values will keep their relative positions.
-void Agent::SortKeyValue(int32* keys, float32* values, int32 size) {
-  std::map<int32, int32> key_map;
-  std::vector<float32> tmp_values(values, values + size);
-
-  for (int32 i = 0; i < size; i++) key_map.insert(std::make_pair(keys[i], i));
-  size = 0;
-  for (auto item : key_map) {
-    keys[size] = item.first;
-    values[size++] = tmp_values[item.second];
-  }
-  tmp_values.clear();
-  key_map.clear();
-}
+DEFINE_int32(shm_capacity, 1 << 20,
+             "Number of key-value pairs the shared memory with the worker "
+             "has room for at start, it grows when more are written.");
+DEFINE_bool(binary_payload, true,
+            "Pack keys and values of push and pull requests into the binary "
+            "payload instead of the repeated fields.");
+DEFINE_bool(delta_keys, true,
+            "Delta encode the sorted keys in the binary payload.");
+DEFINE_bool(delta_pull, false,
+            "Keep the pulled parameters, and pull only the keys changed "
+            "since the version they were pulled at.");
+DEFINE_bool(range_pull, true,
+            "Pull the slices of consecutive keys as ranges, which are sent "
+            "and answered without the keys.");
+
+DEFINE_bool(combine_keys, true,
+            "Sum the gradients of the same key before pushing them, so a "
+            "server receives one gradient per key in a push.");
+DEFINE_int32(agent_threads, 4,
+             "Number of threads serializing requests to the servers and "
+             "parsing their replies.");
+DEFINE_int32(sort_threads, 4,
+             "Number of threads sorting a large key-value list in the agent.");
 
 // To Initialize the agent.
 bool Agent::Initialize(std::string para_fifo_name, 
@@ -162,20 +174,20 @@ bool Agent::Initialize(std::string para_fifo_name,
   para_memory_name_ = para_memory_name;
   grad_memory_name_ = grad_memory_name;
 
-  int32 fd = shm_open(para_memory_name_.c_str(), O_RDWR | O_CREAT, FILE_MODE);
-  ftruncate(fd, sizeof(struct shmstruct));
-  close(fd);
-  fd = shm_open(grad_memory_name_.c_str(), O_RDWR | O_CREAT, FILE_MODE);
-  ftruncate(fd, sizeof(struct shmstruct));
-  close(fd);
-
   // Agent is reader for parameters and writer for gradients
   mkfifo(para_fifo_name_.c_str(), 0777);
   mkfifo(grad_fifo_name_.c_str(), 0777);
   para_fifo_.Initialize(para_fifo_name_, false);
   grad_fifo_.Initialize(grad_fifo_name_, true);
-  para_memory_.Initialize(para_memory_name_.c_str());
-  grad_memory_.Initialize(grad_memory_name_.c_str());
+  if (!para_memory_.Initialize(para_memory_name_.c_str(),
+                               FLAGS_shm_capacity) ||
+      !grad_memory_.Initialize(grad_memory_name_.c_str(),
+                               FLAGS_shm_capacity)) {
+    LOG(ERROR) << "Failed to initialize the shared memory";
+    return false;
+  }
+  sorter_.set_threads(FLAGS_sort_threads);
+  pool_.reset(new ThreadPool(FLAGS_agent_threads));
 
   // 5.Set the epoch_num_ to 0
   epoch_num_ = 0;
@@ -231,36 +243,21 @@ bool Agent::AgentWork() {
     // case 0: Pull request from worker
     if (signal_type == 0) {
       cout << "Agent: Receive pull request from worker" << endl;
-      parameters_ = *grad_memory_.Read();
-      cout << "Agent: Pull size = " << parameters_.size << ": ";
-      for (int32 i = 0; i < parameters_.size; i++) 
-        cout << parameters_.keys[i] << " ";
-      cout << endl;
+      // The worker writes the keys to pull in the gradient memory, and the
+      // replies are decoded straight into the parameter memory.
+      gradients_ = grad_memory_.Read();
+      cout << "Agent: Pull size = " << gradients_->size << endl;
       cout << "Agent: Try to Pull" << endl;
       Pull();
-      cout << "Agent: Write parameters to memory" << endl;
-      para_memory_.Write(&parameters_);
-      cout << "Agent: parameters_.size = " << parameters_.size << endl;
-      cout << "Agent: (key, value)s are as follows:" << endl;
-      for (int32 i = 0; i < parameters_.size; i++) {
-        cout << "(" << parameters_.keys[i] << ", " << parameters_.values[i]
-             << ")" << ", ";
-      }
-      cout << endl;
+      cout << "Agent: parameters_->size = " << parameters_->size << endl;
       cout << "Agent: Signal to the worker" << endl;
       para_fifo_.Signal(2);
       cout << "Pull Done" << endl;
     } else if (signal_type == 1) {
     // case 1: Push request from worker
-      cout << "Agent: Read gradients from memory" << endl;
-      gradients_ = *grad_memory_.Read();
-      cout << "Agent: gradients_.size = " << gradients_.size << endl;
-      cout << "(key, value)s are as follows:" << endl;
-      for (int32 i = 0; i < gradients_.size; i++) {
-        cout << "(" << gradients_.keys[i] << ", " << gradients_.values[i]
-             << ")" << ", ";
-      }
-      cout << endl;
+      // The gradients are sorted and serialized where the worker wrote them.
+      gradients_ = grad_memory_.Read();
+      cout << "Agent: gradients_->size = " << gradients_->size << endl;
       cout << "Agent: Try to Push" << endl;
       Push();
       epoch_num_++;
@@ -285,76 +282,204 @@ bool Agent::AgentWork() {
   return true;
 }
 
-bool Agent::Push() {
-  int32 start, end, server_id, size;
+void Agent::SplitKeys(const int32* keys, int32 size) {
+  partition_.Split(keys, size, &ranges_);
+  slices_.clear();
+  for (const Partition::KeyRange& range : ranges_) {
+    slices_.push_back(Slice{range.start, range.end,
+                            server_ids_[range.server]});
+  }
+}
+
+void Agent::SendSlice(const Slice& slice, const int32* keys,
+                      const float32* values) {
   Message msg_send;
-  Message_RequestMessage* request_msg_ptr;
+  msg_send.set_message_type(Message_MessageType_request);
+  msg_send.set_send_id(local_id_);
+  msg_send.set_recv_id(slice.server_id);
+  Message_RequestMessage* request_msg_ptr = msg_send.mutable_request_msg();
+  int32 size = slice.end - slice.start;
+  if (values == NULL && FLAGS_delta_pull) {
+    request_msg_ptr->set_delta(true);
+    request_msg_ptr->set_since_version(PulledVersion(slice, keys));
+  }
+  if (values == NULL && FLAGS_range_pull && IsRange(keys, slice)) {
+    request_msg_ptr->set_request_type(Message_RequestMessage_RequestType_range);
+    request_msg_ptr->set_start_key(keys[slice.start]);
+    request_msg_ptr->set_length(size);
+  } else {
+    request_msg_ptr->set_request_type(
+        values != NULL ? Message_RequestMessage_RequestType_key_value
+                       : Message_RequestMessage_RequestType_key);
+    SetKeyValues(keys + slice.start,
+                 values != NULL ? values + slice.start : NULL, size,
+                 FLAGS_binary_payload, FLAGS_delta_keys, request_msg_ptr);
+  }
   std::string request_str;
+  msg_send.SerializeToString(&request_str);
+  if (sender_->Send(slice.server_id, std::move(request_str)) == -1) {
+    LOG(ERROR) << "Cannot send " << (values != NULL ? "push" : "pull")
+               << " message to server:" << slice.server_id;
+  }
+}
 
-  // Sort the key_value_list_ by the key, and then send them by blocks.
-  cout << "Agent: Before SortKeyValue : " << endl;
-  cout << "Agent: gradients_.size = " << gradients_.size << endl;
-  cout << "(key, value)s are as follows:" << endl;
-  for (int32 i = 0; i < gradients_.size; i++) {
-    cout << "(" << gradients_.keys[i] << ", " << gradients_.values[i]
-         << ")" << ", ";
+bool Agent::Push() {
+  int32 size;
+
+  // Sort the gradients by the key in the shared memory, sum up those of the
+  // same key, and then send them by blocks.
+  int32* keys = gradients_->keys();
+  float32* values = gradients_->values();
+  size = gradients_->size;
+  sorter_.Sort(keys, values, size);
+  if (FLAGS_combine_keys) size = CombineKeyValue(keys, values, size);
+  cout << "Agent: push size = " << size << " of " << gradients_->size << endl;
+
+  // Divide key list and value list by servers. The slices are serialized in
+  // the thread pool, and each is sent as soon as it is ready.
+  SplitKeys(keys, size);
+  for (const Slice& slice : slices_) {
+    pool_->Schedule([this, &slice, keys, values] {
+      SendSlice(slice, keys, values);
+    });
   }
-  cout << endl;
-  
-  SortKeyValue(gradients_.keys, gradients_.values, gradients_.size);
-  cout << "Agent: After SortKeyValue : " << endl;
-  cout << "Agent: gradients_.size = " << gradients_.size << endl;
-  cout << "(key, value)s are as follows:" << endl;
-  for (int32 i = 0; i < gradients_.size; i++) {
-    cout << "(" << gradients_.keys[i] << ", " << gradients_.values[i]
-         << ")" << ", ";
-  }
-  cout << endl;
-  
-  // Set the message type
-  msg_send.set_message_type(Message_MessageType_request);
+  pool_->Wait();
+  return true;
+}
 
-  // Set send_id
-  msg_send.set_send_id(local_id_);
+int32 Agent::PulledVersion(const Slice& slice, const int32* keys) {
+  PulledParameters* pulled = pulled_[slice.server_id].get();
+  std::lock_guard<std::mutex> lock(pulled->mutex);
+  int32 version = std::numeric_limits<int32>::max();
+  for (int32 i = slice.start; i < slice.end && version >= 0; ++i) {
+    auto it = pulled->values.find(keys[i]);
+    version = std::min(version, it == pulled->values.end()
+                                    ? -1 : it->second.second);
+  }
+  return version;
+}
 
-  // Divide key list and value list and send them to different serverss
-  start = 0;
-  size = gradients_.size;
-  cout << "Agent: gradients_.size = " << gradients_.size << endl;
-  while (start < size) {
-    end = partition_.NextEnding(std::vector<int>(gradients_.keys,
-                              gradients_.keys + gradients_.size), 
-                              start, server_id);
-    cout << "Agent_server_id_list" << endl;
-    for (auto item : server_ids_) {
-      cout << item << ", ";
+void Agent::ReadDeltaReply(const Slice& slice, const int32* keys,
+                           int32 version, const KeyValueReader& reader) {
+  PulledParameters* pulled = pulled_[slice.server_id].get();
+  std::lock_guard<std::mutex> lock(pulled->mutex);
+  for (int32 i = 0; i < reader.size(); ++i)
+    pulled->values[reader.keys()[i]].first = reader.values()[i];
+  // The keys not in the reply did not change up to version.
+  float32* values = parameters_->values();
+  for (int32 i = slice.start; i < slice.end; ++i) {
+    std::pair<float32, int32>& value = pulled->values[keys[i]];
+    value.second = version;
+    values[i] = value.first;
+  }
+  memcpy(parameters_->keys() + slice.start, keys + slice.start,
+         (slice.end - slice.start) * sizeof(int32));
+}
+
+bool Agent::ReadPullReply(const std::string& msg_str) {
+  Message msg_recv;
+  if (!msg_recv.ParseFromString(msg_str)) {
+    LOG(ERROR) << "Agent receives a message which cannot be parsed";
+    return false;
+  }
+  // Ignore wrong messages
+  // Check the message type
+  if (msg_recv.message_type() != Message_MessageType_request) {
+    LOG(ERROR) << "Agent receives a message with wrong message_type";
+    return false;
+  }
+  // Check the message content
+  if (!msg_recv.has_request_msg()) {
+    LOG(ERROR) << "Agent receives a message without request_message";
+    return false;
+  }
+  // Check the message's recv_id
+  if (msg_recv.recv_id() != local_id_) {
+    LOG(ERROR) << "Agent receives a message with a wrong recv_id";
+    return false;
+  }
+  // Parse the request_msg
+  // Check the request_msg's type
+  // A range reply carries the values of consecutive keys from the first one.
+  // A delta reply carries the changed keys of the requested ones, which
+  // start from start_key.
+  const Message_RequestMessage& request_msg = msg_recv.request_msg();
+  KeyValueReader reader;
+  int32 first, size;
+  const float32* values;
+  bool range = request_msg.request_type() ==
+               Message_RequestMessage_RequestType_range;
+  if (request_msg.delta()) {
+    if (request_msg.request_type() !=
+            Message_RequestMessage_RequestType_key_value ||
+        !reader.Parse(request_msg) || request_msg.length() <= 0 ||
+        (reader.size() > 0 && reader.values() == NULL)) {
+      LOG(ERROR) << "Agent receives a malformed reply";
+      return false;
     }
-    cout << endl;
-    cout << "Agent: start, end = " << start << ", " << end << endl;
-    server_id = server_ids_[server_id];
-    cout << "Agent: server_id = " << server_id << endl;
-    msg_send.clear_request_msg();
-    request_msg_ptr = new Message_RequestMessage();
-    request_msg_ptr->set_request_type
-                 (Message_RequestMessage_RequestType_key_value);                  
-    request_msg_ptr->clear_keys();
-    request_msg_ptr->clear_values();
-    for (int32 i = start; i < end; i++) {
-      request_msg_ptr->add_keys(gradients_.keys[i]);
-      request_msg_ptr->add_values(gradients_.values[i]);
+    first = request_msg.start_key();
+    size = request_msg.length();
+    values = NULL;
+  } else if (range) {
+    first = request_msg.start_key();
+    size = request_msg.length();
+    if (size <= 0 ||
+        request_msg.payload().size() != size * sizeof(float32)) {
+      LOG(ERROR) << "Agent receives a malformed reply";
+      return false;
     }
-    msg_send.set_allocated_request_msg(request_msg_ptr);
-    msg_send.set_recv_id(server_id);
-    msg_send.SerializeToString(&request_str);
-    cout << "Agent: Send 'push' to server" << endl;
-    if (sender_->Send(server_id, request_str) == -1) {
-      LOG(INFO) << "Cannot send push message to server:" << server_id;
-      LOG(ERROR) << "Cannot send push message to server:" << server_id;
+    values = reinterpret_cast<const float32*>(request_msg.payload().data());
+  } else if (request_msg.request_type() ==
+             Message_RequestMessage_RequestType_key_value) {
+    if (!reader.Parse(request_msg) || reader.size() == 0 ||
+        reader.values() == NULL) {
+      LOG(ERROR) << "Agent receives a malformed reply";
+      return false;
     }
-
-    start = end;
+    first = reader.keys()[0];
+    size = reader.size();
+    values = reader.values();
+  } else {
+    LOG(ERROR) << "Agent receives a message with wrong request_type";
+    return false;
   }
 
+  // The slices hold disjoint ranges of the sorted keys, so the first key of
+  // the reply tells which slice it answers.
+  const int32* keys = gradients_->keys();
+  auto it = std::upper_bound(slices_.begin(), slices_.end(), first,
+                             [keys](int32 key, const Slice& slice) {
+                               return key < keys[slice.start];
+                             });
+  if (it == slices_.begin()) {
+    LOG(ERROR) << "Agent receives parameters it did not request";
+    return false;
+  }
+  --it;
+  int32 index = it - slices_.begin();
+  if (keys[it->start] != first || it->server_id != msg_recv.send_id() ||
+      it->end - it->start != size || (range && !IsRange(keys, *it))) {
+    LOG(ERROR) << "Agent receives a reply which does not match its request";
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(reply_mutex_);
+    if (replied_[index]) {
+      LOG(ERROR) << "Agent receives a second reply from server "
+                 << it->server_id;
+      return false;
+    }
+    replied_[index] = true;
+  }
+  if (request_msg.delta()) {
+    ReadDeltaReply(*it, keys, request_msg.version(), reader);
+    return true;
+  }
+  // The keys of a range reply are the requested ones.
+  memcpy(parameters_->keys() + it->start, range ? keys + it->start
+                                                : reader.keys(),
+         size * sizeof(int32));
+  memcpy(parameters_->values() + it->start, values, size * sizeof(float32));
   return true;
 }
 
@@ -362,134 +487,72 @@ bool Agent::Pull() {
   // Agent will sort the key_list_, and send pull request to servers by blocks.
   // Then it will wait until it has received all the replies from the servers
   // the agent have requested to
-  int32 start, end, server_id, size;
-  Message msg_send_recv;
-  Message_RequestMessage* request_msg_ptr;
-  std::string msg_str;
-  std::set<int32> server_set;
-
-  // Sort the key_list_
-  std::sort(parameters_.keys, parameters_.keys + parameters_.size);
-
-  // Set the message type
-  msg_send_recv.set_message_type(Message_MessageType_request);
-
-  // Set send_id
-  msg_send_recv.set_send_id(local_id_);
+  int32 size;
+
+  // Sort the keys in the shared memory
+  int32* keys = gradients_->keys();
+  size = gradients_->size;
+  sorter_.Sort(keys, NULL, size);
+
+  // The replies are written straight into the parameter memory, which has
+  // room for every requested key. Each reply goes to the range of its slice,
+  // so the parameters are in the order of the sorted keys.
+  if (!para_memory_.Reserve(size)) {
+    LOG(ERROR) << "Cannot make room for " << size << " parameters";
+    return false;
+  }
+  parameters_ = para_memory_.Read();
+  parameters_->size = 0;
 
   // Divide key list and send them to different servers
-  start = 0;
-  size = parameters_.size;
-  while (start < size) {
-    end = partition_.NextEnding(std::vector<int>(parameters_.keys,
-                              parameters_.keys + parameters_.size),
-                              start, server_id);
-    cout << "Agent: start, end = " << start << ", " << end << endl;
-    server_id = server_ids_[server_id];
-    cout << "Agent: server_id = " << server_id << endl;
-    server_set.insert(server_id);
-    msg_send_recv.clear_request_msg();
-    request_msg_ptr = new Message_RequestMessage();
-    request_msg_ptr->set_request_type(Message_RequestMessage_RequestType_key);
-    request_msg_ptr->clear_keys();
-    for (int32 i = start; i < end; i++) {
-      request_msg_ptr->add_keys(parameters_.keys[i]);
-    }
-    msg_send_recv.set_allocated_request_msg(request_msg_ptr);
-    msg_send_recv.set_recv_id(server_id);
-    msg_send_recv.SerializeToString(&msg_str);
-    cout << "Agent: Send 'pull' to server" << endl;
-    if (sender_->Send(server_id, msg_str) == -1) {
-      LOG(INFO) << "Cannot send pull message to server:" << server_id;
-      LOG(ERROR) << "Cannot send pull message to server:" << server_id;
+  SplitKeys(keys, size);
+  replied_.assign(slices_.size(), false);
+  if (FLAGS_delta_pull) {
+    for (const Slice& slice : slices_) {
+      std::unique_ptr<PulledParameters>& pulled = pulled_[slice.server_id];
+      if (pulled == NULL) pulled.reset(new PulledParameters());
     }
-
-    start = end;
   }
+  for (const Slice& slice : slices_) {
+    pool_->Schedule([this, &slice, keys] {
+      SendSlice(slice, keys, NULL);
+    });
+  }
+  pool_->Wait();
 
   // Receive parameters from servers
   // PS: Maybe I will add a timer for this loop. Beacuse I want to avoid
   // infinite loop caused by crashed server or servers.
 
-  int32 cur = 0;
-  parameters_.size = 0;
-  
-  cout << "Agent: Start waiting for server's response" << endl;
-  cout << "Agent: server_set: " << server_set.size() << endl;
-  for (auto item : server_set) {
-    cout << item << endl;
-  }
-  while (!server_set.empty()) {
-    if (receiver_->Receive(&msg_str) == -1) {
-      cout << "Agent: Error in receiving message from servers" << endl;
-      LOG(ERROR) << "Error in receiving message from servers";
-    } else {
-      msg_send_recv.ParseFromString(msg_str);
-      cout << "Agent: Receive " << msg_send_recv.DebugString() << endl;
-      
-      // Ignore wrong messages
-      // Check the message type
-      cout << "Agent: Check the message from server" << endl;
-      if (msg_send_recv.message_type() != Message_MessageType_request) {
-        LOG(ERROR) << "Agent receives a message with wrong message_type";
-        continue;
-      }
-      // Check the message content
-      if (!msg_send_recv.has_request_msg()) {
-        LOG(ERROR) << "Agent receives a message without request_message";
-        continue;
-      }
-      // Check the message's send_id
-      if (server_set.find(msg_send_recv.send_id()) == server_set.end()) {
-        LOG(ERROR) << "Agent receives a message from an unknown sender";
-        continue;
-      }
-      // Check the message's recv_id
-      if (msg_send_recv.recv_id() != local_id_) {
-        LOG(ERROR) << "Agent receives a message with a wrong recv_id";
-        continue;
-      }
-
-      // Parse the request_msg
-      // Check the request_msg's type
-      Message_RequestMessage request_msg = msg_send_recv.request_msg();
-      // PS: Maybe the agent will send a feedback message to server in the
-      // future
-      if (request_msg.request_type() !=
-          Message_RequestMessage_RequestType_key_value) {
-        LOG(ERROR) << "Agent receives a message with wrong request_type";
+  // The replies are received here, and parsed and copied in the thread pool.
+  // A reply may turn out to be wrong, so when as many messages as slices
+  // have been received, the agent waits for the pool and receives as many
+  // more as were rejected.
+  cout << "Agent: Start waiting for " << slices_.size() << " replies" << endl;
+  int32 slices = slices_.size();
+  int32 answered = 0;
+  std::atomic<int32> accepted(0);
+  std::string msg_str;
+  while (answered < slices) {
+    for (int32 i = answered; i < slices; i++) {
+      if (receiver_->Receive(&msg_str) == -1) {
+        cout << "Agent: Error in receiving message from servers" << endl;
+        LOG(ERROR) << "Error in receiving message from servers";
+        i--;
         continue;
       }
-      cout << "Agent: Get response from server " << msg_send_recv.send_id() 
-           << endl;
-      server_set.erase(msg_send_recv.send_id());
-      size = request_msg.keys_size();
-      cout << "Agent: Receive " << size << " key_value pairs" << endl;
-      cout << "Agent: cur = " <<  cur << endl;
-      // PS: Maybe I will allocate stable space for part_keys and part_values,
-      // if I know the maximal number of key-value pairs
-      // Extract parameter keys from the message
-      
-      for (int32 i = 0; i < size; i++) {
-        parameters_.keys[cur + i] = request_msg.keys(i);
-        parameters_.values[cur + i] = request_msg.values(i);
-      }
-      /*
-      int32* part_keys = new int32[size];
-      request_msg.mutable_keys()->ExtractSubrange(0, size, part_keys);
-      memcpy(parameters_.keys + cur * 4, part_keys, size * 4);
-      delete[] part_keys;
-      // Extract parameter values from the message
-      float32* part_values = new float32[size];
-      request_msg.mutable_values()->ExtractSubrange(0, size, part_values);
-      memcpy(parameters_.values + cur * 4, part_values, size * 4);
-      delete[] part_values;
-      */
-      cur += size;
+      // The task owns the message from here on.
+      std::shared_ptr<std::string> reply(new std::string());
+      reply->swap(msg_str);
+      pool_->Schedule([this, reply, &accepted] {
+        if (ReadPullReply(*reply)) accepted++;
+      });
     }
+    pool_->Wait();
+    answered = accepted.load();
   }
-  parameters_.size = cur;
-  cout << "Agent: parameters_.size = " << parameters_.size << endl;
+  parameters_->size = size;
+  cout << "Agent: parameters_->size = " << parameters_->size << endl;
   return true;
 }
 
@@ -560,6 +623,8 @@ void Agent::Reconfigurate() {
   agent_num_ = config_msg.worker_num();
   server_num_ = config_msg.server_num();
   key_range_  = config_msg.key_range();
+  // The keys may move to other servers, whose versions are unrelated.
+  pulled_.clear();
 
   cout << "Reinitialization " << "local_id = " << local_id_
        << " agent_num_ = " << agent_num_ << " server_num_ = "
@@ -10,15 +10,19 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
+#include "src/agent/key_value_sort.h"
 #include "src/agent/partition.h"
 #include "src/channel/fifo.h"
 #include "src/channel/shared_memory.h"
 #include "src/communication/communicator.h"
+#include "src/message/key_value_codec.h"
 #include "src/message/message.pb.h"
 #include "src/util/common.h"
+#include "src/util/thread_pool.h"
 
 
 namespace rpscc {
@@ -30,7 +34,7 @@ namespace rpscc {
 // the worker.
 class Agent {
  public:
-  Agent() {}
+  Agent() : gradients_(NULL), parameters_(NULL) {}
   ~Agent() {}
   // Initialzie the agent
   // Parameters:
@@ -84,15 +88,44 @@ class Agent {
   std::vector<int32> keys_;
   std::vector<float32> values_;
 
-  // gradients_ is read from worker, and it will be pushed to servers
-  shmstruct gradients_;
+  // gradients_ points to the gradient memory written by the worker, the
+  // gradients in it are pushed to servers, or the keys in it are pulled.
+  shmstruct* gradients_;
 
-  // parameters_ is pulled from servers, and it will be sent to worker
-  shmstruct parameters_;
+  // parameters_ points to the parameter memory, the parameters pulled from
+  // servers are written into it for the worker.
+  shmstruct* parameters_;
+
+  // Sorter for the pushed gradients and the pulled keys
+  KeyValueSorter sorter_;
 
   // Partition message to server
   Partition partition_;
 
+  // A range [start, end) of the sorted keys which belongs to server_id.
+  struct Slice {
+    int32 start;
+    int32 end;
+    int32 server_id;
+  };
+  // The slices of the keys being pushed or pulled, and for a pull, whether
+  // the reply of each slice has arrived.
+  std::vector<Partition::KeyRange> ranges_;
+  std::vector<Slice> slices_;
+  std::vector<bool> replied_;
+  std::mutex reply_mutex_;
+
+  // The parameters pulled from a server with --delta_pull, with the version
+  // of the server each was last pulled at, by server id.
+  struct PulledParameters {
+    std::mutex mutex;
+    std::unordered_map<int32, std::pair<float32, int32>> values;
+  };
+  std::map<int32, std::unique_ptr<PulledParameters>> pulled_;
+
+  // Threads serializing requests and parsing replies
+  std::unique_ptr<ThreadPool> pool_;
+
   // Thread for heartbeat
   pthread_t heartbeat_;
 
@@ -106,12 +139,31 @@ class Agent {
   bool Push();
   bool Pull();
 
+  // Divide the sorted keys into slices_ by servers.
+  void SplitKeys(const int32* keys, int32 size);
+  // Whether the sorted keys of slice are consecutive, so that it can be
+  // pulled as a range. A slice with a key pulled twice is not.
+  static bool IsRange(const int32* keys, const Slice& slice) {
+    return IsConsecutive(keys + slice.start, slice.end - slice.start);
+  }
+  // Serialize the keys and values of slice, and send them to its server.
+  // values is NULL for a pull request, which is sent as a range if its keys
+  // are consecutive.
+  void SendSlice(const Slice& slice, const int32* keys, const float32* values);
+  // Copy the parameters of a pull reply to the range of its slice in the
+  // parameter memory. Return false if the reply is wrong.
+  bool ReadPullReply(const std::string& msg_str);
+  // The oldest version at which a key of slice was pulled, -1 if one never
+  // was.
+  int32 PulledVersion(const Slice& slice, const int32* keys);
+  // Update the pulled parameters of slice with the changed ones in reader,
+  // and copy them to the range of slice in the parameter memory.
+  void ReadDeltaReply(const Slice& slice, const int32* keys, int32 version,
+                      const KeyValueReader& reader);
+
   // HeartBeat with master
   static void* HeartBeat(void* arg);
 
-  // To sort the key list and value list
-  void SortKeyValue(int32* keys, float32* values, int32 size);
-
   // Reconfigigurate the agent when the master send a ConfigMessage
   // to agent not for the first time
   void Reconfigurate();
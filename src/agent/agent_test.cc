@@ -317,29 +317,24 @@ void Work() {
   std::string str;
   Fifo para_fifo, grad_fifo;
   SharedMemory para_memory, grad_memory;
-  shmstruct parameters, gradients;
+  shmstruct* parameters;
+  std::vector<int32> keys;
+  std::vector<float32> values;
   
   string para_fifo_name = "/tmp/cute_para_fifo";
   string grad_fifo_name = "/tmp/cute_grad_fifo";
   string para_memory_name = "/cute_para_mem";
   string grad_memory_name = "/cute_grad_mem";
   
-  int fd = shm_open(para_memory_name.c_str(), O_RDWR | O_CREAT, FILE_MODE);
-  ftruncate(fd, sizeof(struct shmstruct));
-  fd = shm_open(grad_memory_name.c_str(), O_RDWR | O_CREAT, FILE_MODE);
-  ftruncate(fd, sizeof(struct shmstruct));
-  close(fd);
-  
   para_fifo.Initialize(para_fifo_name, true);
   grad_fifo.Initialize(grad_fifo_name, false);
   para_memory.Initialize(para_memory_name.c_str());
   grad_memory.Initialize(grad_memory_name.c_str());
   para_fifo.Open();
   grad_fifo.Open();
-  gradients.size = 5;
   for (int i = 0; i < 5; i++) {
-    gradients.keys[i] = 4 - i;
-    gradients.values[i] = 4 - i + 10;
+    keys.push_back(4 - i);
+    values.push_back(4 - i + 10);
   }
   
   while (true) {
@@ -348,28 +343,28 @@ void Work() {
     if (str == "0") {
       cout << "Worker: Pull request to agent" << endl;
       cout << "(key)s are as follows" << endl;
-      for (int i = 0; i < gradients.size; i++) cout << gradients.keys[i] << " ";
+      for (int i = 0; i < keys.size(); i++) cout << keys[i] << " ";
       cout << endl;
-      grad_memory.Write(&gradients);
+      grad_memory.Write(keys.data(), values.data(), keys.size());
       grad_fifo.Signal(0);
       cout << "Worker: Wait for agent's parameters" << endl;
       para_fifo.Wait();
       cout << "Worker: Get parameters from agent" << endl;
-      parameters = *para_memory.Read();
-      cout << "Worker: Get " << parameters.size << " parameters from agent"
+      parameters = para_memory.Read();
+      cout << "Worker: Get " << parameters->size << " parameters from agent"
            << endl;
       cout << "(key, value)s are as follows" << endl;
-      for (int i = 0; i < parameters.size; i++) {
-        cout << "(" << parameters.keys[i] << ", " << parameters.values[i]
+      for (int i = 0; i < parameters->size; i++) {
+        cout << "(" << parameters->keys()[i] << ", " << parameters->values()[i]
              << ")" << ", ";
       }
       cout << endl;
       cout << "Worker: A pull request's loop is done" << endl;
     } else if (str == "1") {
       cout << "Worker: Push request to agent" << endl;
-      cout << "Worker: Transfer " << gradients.size << " gradients to agent"
+      cout << "Worker: Transfer " << keys.size() << " gradients to agent"
          << endl;
-      grad_memory.Write(&gradients);
+      grad_memory.Write(keys.data(), values.data(), keys.size());
       grad_fifo.Signal(1);
       cout << "Worker: A push request is done" << endl;
     } else {
@@ -0,0 +1,183 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/agent/key_value_sort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace rpscc {
+
+namespace {
+
+const int32 kBuckets = 256;
+const int32 kPasses = 4;
+
+// Flipping the sign bit makes the order of unsigned keys the order of the
+// signed keys.
+inline uint32 Flip(int32 key) {
+  return static_cast<uint32>(key) ^ 0x80000000u;
+}
+
+inline int32 Unflip(uint32 key) {
+  return static_cast<int32>(key ^ 0x80000000u);
+}
+
+inline uint32 Digit(uint32 key, int32 pass) {
+  return (key >> (pass * 8)) & (kBuckets - 1);
+}
+
+// Move the pairs in [begin, end) of src to dst by the digit of pass, offsets
+// are the positions in dst of the next pair of every digit.
+void Scatter(const uint32* src_keys, const float32* src_values,
+             uint32* dst_keys, float32* dst_values, int32 begin, int32 end,
+             int32 pass, int32* offsets) {
+  if (src_values == NULL) {
+    for (int32 i = begin; i < end; i++) {
+      dst_keys[offsets[Digit(src_keys[i], pass)]++] = src_keys[i];
+    }
+    return;
+  }
+  for (int32 i = begin; i < end; i++) {
+    int32 pos = offsets[Digit(src_keys[i], pass)]++;
+    dst_keys[pos] = src_keys[i];
+    dst_values[pos] = src_values[i];
+  }
+}
+
+// Run function(t) for t in [0, threads), and wait for all of them.
+template <typename Function>
+void RunThreads(int32 threads, const Function& function) {
+  std::vector<std::thread> workers;
+  for (int32 t = 1; t < threads; t++) workers.emplace_back(function, t);
+  function(0);
+  for (auto& worker : workers) worker.join();
+}
+
+}  // namespace
+
+void KeyValueSorter::InsertionSort(int32* keys, float32* values,
+                                   int32 size) {
+  for (int32 i = 1; i < size; i++) {
+    int32 key = keys[i];
+    float32 value = values != NULL ? values[i] : 0;
+    int32 j = i;
+    for (; j > 0 && keys[j - 1] > key; j--) {
+      keys[j] = keys[j - 1];
+      if (values != NULL) values[j] = values[j - 1];
+    }
+    keys[j] = key;
+    if (values != NULL) values[j] = value;
+  }
+}
+
+void KeyValueSorter::Sort(int32* keys, float32* values, int32 size) {
+  if (size < kInsertionSortSize) {
+    InsertionSort(keys, values, size);
+    return;
+  }
+  int32 threads = size >= kParallelSize ? std::max(threads_, 1) : 1;
+  int32 block = (size + threads - 1) / threads;
+
+  // The keys go back and forth between the two halves of key_buffer_, and
+  // the values between values and value_buffer_.
+  key_buffer_.resize(2 * static_cast<size_t>(size));
+  uint32* src_keys = key_buffer_.data();
+  uint32* dst_keys = src_keys + size;
+  float32* src_values = values;
+  float32* dst_values = NULL;
+  if (values != NULL) {
+    value_buffer_.resize(size);
+    dst_values = value_buffer_.data();
+  }
+
+  // Count the digits of every pass while flipping the keys in.
+  std::vector<int32> counts(threads * kPasses * kBuckets, 0);
+  RunThreads(threads, [&](int32 t) {
+    int32* count = counts.data() + t * kPasses * kBuckets;
+    int32 end = std::min(size, (t + 1) * block);
+    for (int32 i = t * block; i < end; i++) {
+      uint32 key = Flip(keys[i]);
+      src_keys[i] = key;
+      for (int32 pass = 0; pass < kPasses; pass++)
+        count[pass * kBuckets + Digit(key, pass)]++;
+    }
+  });
+  std::vector<int32> totals(kPasses * kBuckets, 0);
+  for (int32 t = 0; t < threads; t++) {
+    for (int32 i = 0; i < kPasses * kBuckets; i++)
+      totals[i] += counts[t * kPasses * kBuckets + i];
+  }
+
+  std::vector<int32> offsets(threads * kBuckets);
+  for (int32 pass = 0; pass < kPasses; pass++) {
+    const int32* total = totals.data() + pass * kBuckets;
+    // Every key has the same digit, nothing would move.
+    if (total[Digit(src_keys[0], pass)] == size) continue;
+
+    if (threads == 1) {
+      int32 sum = 0;
+      for (int32 d = 0; d < kBuckets; d++) {
+        offsets[d] = sum;
+        sum += total[d];
+      }
+      Scatter(src_keys, src_values, dst_keys, dst_values, 0, size, pass,
+              offsets.data());
+    } else {
+      // The block of a thread has moved since the first count, so the
+      // digits are counted again for this pass.
+      RunThreads(threads, [&](int32 t) {
+        int32* count = counts.data() + t * kBuckets;
+        std::fill(count, count + kBuckets, 0);
+        int32 end = std::min(size, (t + 1) * block);
+        for (int32 i = t * block; i < end; i++)
+          count[Digit(src_keys[i], pass)]++;
+      });
+      // The pairs of thread t with digit d go after those of every smaller
+      // digit and after those of the threads before t with digit d.
+      int32 sum = 0;
+      for (int32 d = 0; d < kBuckets; d++) {
+        for (int32 t = 0; t < threads; t++) {
+          offsets[t * kBuckets + d] = sum;
+          sum += counts[t * kBuckets + d];
+        }
+      }
+      RunThreads(threads, [&](int32 t) {
+        Scatter(src_keys, src_values, dst_keys, dst_values, t * block,
+                std::min(size, (t + 1) * block), pass,
+                offsets.data() + t * kBuckets);
+      });
+    }
+    std::swap(src_keys, dst_keys);
+    std::swap(src_values, dst_values);
+  }
+
+  for (int32 i = 0; i < size; i++) keys[i] = Unflip(src_keys[i]);
+  if (values != NULL && src_values != values)
+    memcpy(values, src_values, size * sizeof(float32));
+}
+
+int32 CombineKeyValue(int32* keys, float32* values, int32 size) {
+  if (size <= 0) return 0;
+  // Nothing moves before the first duplicate.
+  int32 last = 0;
+  while (last + 1 < size && keys[last + 1] != keys[last]) last++;
+  for (int32 i = last + 1; i < size; i++) {
+    if (keys[i] == keys[last]) {
+      values[last] += values[i];
+    } else {
+      last++;
+      keys[last] = keys[i];
+      values[last] = values[i];
+    }
+  }
+  return last + 1;
+}
+
+bool IsConsecutive(const int32* keys, int32 size) {
+  for (int32 i = 1; i < size; i++)
+    if (keys[i] != keys[i - 1] + 1) return false;
+  return true;
+}
+
+}  // namespace rpscc
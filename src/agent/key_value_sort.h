@@ -0,0 +1,54 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#ifndef SRC_AGENT_KEY_VALUE_SORT_H_
+#define SRC_AGENT_KEY_VALUE_SORT_H_
+
+#include <vector>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// KeyValueSorter sorts key lists and value lists by the key with a LSD radix
+// sort, 8 bits per pass. The sort is stable, so pairs with the same key keep
+// their order and none of them is dropped. Passes in which every key has the
+// same digit are skipped, so keys in a small range take fewer passes.
+// Large lists are sorted by several threads, each counting and scattering a
+// contiguous block of the list.
+// The scratch buffers are kept between calls, so a sorter should be reused.
+class KeyValueSorter {
+ public:
+  explicit KeyValueSorter(int32 threads = 1) : threads_(threads) {}
+  ~KeyValueSorter() {}
+
+  // Sort size keys, and values along with them if values is not NULL.
+  void Sort(int32* keys, float32* values, int32 size);
+
+  void set_threads(int32 threads) { threads_ = threads; }
+
+ private:
+  // Lists shorter than this are sorted by insertion sort.
+  static const int32 kInsertionSortSize = 64;
+  // Lists shorter than this are sorted by one thread.
+  static const int32 kParallelSize = 1 << 18;
+
+  void InsertionSort(int32* keys, float32* values, int32 size);
+
+  int32 threads_;
+  std::vector<uint32> key_buffer_;
+  std::vector<float32> value_buffer_;
+};
+
+// Sum the values of the pairs with the same key in a sorted key-value list,
+// in place, so that each key is left once. Values of a key are added in the
+// order of the list, so the sums do not depend on timing. Returns the number
+// of pairs left.
+int32 CombineKeyValue(int32* keys, float32* values, int32 size);
+
+// Whether size sorted keys are consecutive, each one more than the key
+// before it. Keys with duplicates are not, even if they span size keys.
+bool IsConsecutive(const int32* keys, int32 size);
+
+}  // namespace rpscc
+
+#endif  // SRC_AGENT_KEY_VALUE_SORT_H_
@@ -0,0 +1,95 @@
+// Copyright (c) 2019 The RPSCC Authors. All rights reserved.
+//
+// Benchmark for sorting the pushed key-value pairs in the agent.
+// The map based sort which the agent used before is compared with
+// KeyValueSorter, with one thread and with --threads threads, on n random
+// keys drawn from [0, key_range).
+//
+// Usage: ./key_value_sort_benchmark --sizes=1000,10000000 --threads=4
+
+#include <stdio.h>
+
+#include <chrono>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "src/agent/key_value_sort.h"
+
+DEFINE_string(sizes, "1000,10000,100000,1000000,10000000",
+              "Comma separated numbers of key-value pairs to sort.");
+DEFINE_int32(key_range, 1 << 30, "Keys are drawn from [0, key_range).");
+DEFINE_int32(threads, 4, "Number of threads of the parallel sort.");
+DEFINE_int32(rounds, 5, "Number of sorts for each size.");
+
+using rpscc::KeyValueSorter;
+
+namespace {
+
+// The sort of Agent::SortKeyValue before KeyValueSorter, it drops all but
+// the first pair of a key.
+int32 MapSort(int32* keys, float32* values, int32 size) {
+  std::map<int32, int32> key_map;
+  std::vector<float32> tmp_values(values, values + size);
+  for (int32 i = 0; i < size; i++) key_map.insert(std::make_pair(keys[i], i));
+  size = 0;
+  for (auto item : key_map) {
+    keys[size] = item.first;
+    values[size++] = tmp_values[item.second];
+  }
+  return size;
+}
+
+// Return the best time in ms of sorting copies of keys and values.
+template <typename Function>
+double Measure(const std::vector<int32>& keys,
+               const std::vector<float32>& values, const Function& sort) {
+  double best = 0;
+  for (int32 round = 0; round < FLAGS_rounds; round++) {
+    std::vector<int32> round_keys = keys;
+    std::vector<float32> round_values = values;
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    sort(round_keys.data(), round_values.data(), keys.size());
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    if (best == 0 || seconds < best) best = seconds;
+  }
+  return best * 1e3;
+}
+
+void Run(int32 size) {
+  std::mt19937 random(size);
+  std::uniform_int_distribution<int32> distribution(0, FLAGS_key_range - 1);
+  std::vector<int32> keys(size);
+  std::vector<float32> values(size);
+  for (int32 i = 0; i < size; i++) {
+    keys[i] = distribution(random);
+    values[i] = i * 0.5f;
+  }
+
+  KeyValueSorter serial(1), parallel(FLAGS_threads);
+  double map_ms = Measure(keys, values, MapSort);
+  double serial_ms = Measure(keys, values,
+      [&](int32* k, float32* v, int32 n) { serial.Sort(k, v, n); });
+  double parallel_ms = Measure(keys, values,
+      [&](int32* k, float32* v, int32 n) { parallel.Sort(k, v, n); });
+  printf("size = %-10d map %10.3f ms, radix %9.3f ms (%5.1fx), "
+         "radix x%d %9.3f ms (%5.1fx)\n",
+         size, map_ms, serial_ms, map_ms / serial_ms, FLAGS_threads,
+         parallel_ms, map_ms / parallel_ms);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::stringstream sizes(FLAGS_sizes);
+  std::string size;
+  while (std::getline(sizes, size, ',')) Run(std::stoi(size));
+  return 0;
+}
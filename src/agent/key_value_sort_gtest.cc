@@ -0,0 +1,134 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/agent/key_value_sort.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace rpscc;
+
+namespace {
+
+// Sort keys and values with the sorter, and compare with std::stable_sort.
+void ExpectSorted(KeyValueSorter* sorter, std::vector<int32> keys) {
+  std::vector<float32> values(keys.size());
+  std::vector<std::pair<int32, float32>> expected;
+  for (size_t i = 0; i < keys.size(); i++) {
+    values[i] = static_cast<float32>(i);
+    expected.push_back(std::make_pair(keys[i], values[i]));
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::pair<int32, float32>& a,
+                      const std::pair<int32, float32>& b) {
+                     return a.first < b.first;
+                   });
+  sorter->Sort(keys.data(), values.data(), keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(expected[i].first, keys[i]) << "at " << i;
+    // The values of equal keys keep their order.
+    ASSERT_EQ(expected[i].second, values[i]) << "at " << i;
+  }
+}
+
+std::vector<int32> RandomKeys(int32 size, int32 low, int32 high) {
+  std::mt19937 random(size);
+  std::uniform_int_distribution<int32> distribution(low, high);
+  std::vector<int32> keys(size);
+  for (auto& key : keys) key = distribution(random);
+  return keys;
+}
+
+}  // namespace
+
+TEST(KeyValueSortTest, Small) {
+  KeyValueSorter sorter;
+  ExpectSorted(&sorter, {});
+  ExpectSorted(&sorter, {3});
+  ExpectSorted(&sorter, {4, 3, 2, 1, 0, 3, 3});
+}
+
+TEST(KeyValueSortTest, RandomKeys) {
+  KeyValueSorter sorter;
+  for (int32 size : {100, 1000, 100000}) {
+    ExpectSorted(&sorter, RandomKeys(size, 0, 1000));
+    ExpectSorted(&sorter, RandomKeys(size, 0, 1 << 30));
+  }
+}
+
+TEST(KeyValueSortTest, NegativeKeys) {
+  KeyValueSorter sorter;
+  std::vector<int32> keys = RandomKeys(10000, -1000, 1000);
+  keys.push_back(-2147483647 - 1);
+  keys.push_back(2147483647);
+  ExpectSorted(&sorter, keys);
+}
+
+TEST(KeyValueSortTest, Parallel) {
+  for (int32 threads : {2, 3, 8}) {
+    KeyValueSorter sorter(threads);
+    ExpectSorted(&sorter, RandomKeys(1 << 20, -(1 << 28), 1 << 28));
+    ExpectSorted(&sorter, RandomKeys((1 << 20) + 7, 0, 100));
+  }
+}
+
+TEST(KeyValueSortTest, KeysOnly) {
+  KeyValueSorter sorter(4);
+  for (int32 size : {10, 1000, 1 << 20}) {
+    std::vector<int32> keys = RandomKeys(size, -(1 << 20), 1 << 20);
+    std::vector<int32> expected = keys;
+    std::sort(expected.begin(), expected.end());
+    sorter.Sort(keys.data(), NULL, size);
+    EXPECT_EQ(expected, keys);
+  }
+}
+
+TEST(CombineKeyValueTest, SumsDuplicates) {
+  std::vector<int32> keys = {-3, 1, 1, 2, 5, 5, 5};
+  std::vector<float32> values = {1, 2, 3, 4, 5, 6, 7};
+  EXPECT_EQ(4, CombineKeyValue(keys.data(), values.data(), keys.size()));
+  keys.resize(4);
+  values.resize(4);
+  EXPECT_EQ(std::vector<int32>({-3, 1, 2, 5}), keys);
+  EXPECT_EQ(std::vector<float32>({1, 5, 4, 18}), values);
+}
+
+TEST(CombineKeyValueTest, NoDuplicates) {
+  std::vector<int32> keys = {1, 2, 3};
+  std::vector<float32> values = {1, 2, 3};
+  EXPECT_EQ(0, CombineKeyValue(keys.data(), values.data(), 0));
+  EXPECT_EQ(3, CombineKeyValue(keys.data(), values.data(), 3));
+  EXPECT_EQ(std::vector<float32>({1, 2, 3}), values);
+}
+
+TEST(CombineKeyValueTest, AfterSort) {
+  KeyValueSorter sorter;
+  std::vector<int32> keys = RandomKeys(100000, 0, 999);
+  std::vector<float32> values(keys.size(), 1);
+  sorter.Sort(keys.data(), values.data(), keys.size());
+  int32 size = CombineKeyValue(keys.data(), values.data(), keys.size());
+  ASSERT_LE(size, 1000);
+  float32 total = 0;
+  for (int32 i = 0; i < size; i++) {
+    if (i > 0) EXPECT_LT(keys[i - 1], keys[i]);
+    total += values[i];
+  }
+  EXPECT_EQ(100000, total);
+}
+
+TEST(IsConsecutiveTest, Duplicates) {
+  std::vector<int32> keys = {5, 6, 7, 8};
+  EXPECT_TRUE(IsConsecutive(keys.data(), keys.size()));
+  EXPECT_TRUE(IsConsecutive(keys.data(), 1));
+  EXPECT_TRUE(IsConsecutive(keys.data(), 0));
+  // The first and last keys span four keys, but 7 is missing.
+  keys = {5, 6, 6, 8};
+  EXPECT_FALSE(IsConsecutive(keys.data(), keys.size()));
+  keys = {5, 5};
+  EXPECT_FALSE(IsConsecutive(keys.data(), keys.size()));
+  keys = {5, 7};
+  EXPECT_FALSE(IsConsecutive(keys.data(), keys.size()));
+}
@@ -52,17 +52,34 @@ int32 Partition::GetServerByKey(int32 key) {
               - part_vec_.begin() - 1;
 }
 
-int32 Partition::NextEnding(std::vector<int32> keys, int32 start, 
+int32 Partition::NextEnding(const int32* keys, int32 size, int32 start,
                             int32& server_id) {
   server_id = GetServerByKey(keys[start]);
   if (keys[start] < part_vec_[0]) {
-    return lower_bound(keys.begin() + start, keys.end(),  part_vec_[0]) - keys.begin();
+    return std::lower_bound(keys + start, keys + size, part_vec_[0]) - keys;
   } else {
     if (server_id == server_num_ - 1)
-      return keys.end() - keys.begin();
+      return size;
     else
-      return lower_bound(keys.begin() + start, keys.end(),  part_vec_[server_id + 1])
-             - keys.begin();
+      return std::lower_bound(keys + start, keys + size,
+                              part_vec_[server_id + 1]) - keys;
+  }
+}
+
+void Partition::Split(const int32* keys, int32 size,
+                      std::vector<KeyRange>* ranges) {
+  ranges->clear();
+  if (size <= 0 || part_vec_.empty()) return;
+  int32 server_num = part_vec_.size();
+  int32 start = std::lower_bound(keys, keys + size, part_vec_[0]) - keys;
+  if (start > 0) ranges->push_back(KeyRange{0, start, server_num - 1});
+  for (int32 server = 0; server < server_num && start < size; server++) {
+    int32 end = server + 1 < server_num
+                ? std::lower_bound(keys + start, keys + size,
+                                   part_vec_[server + 1]) - keys
+                : size;
+    if (end > start) ranges->push_back(KeyRange{start, end, server});
+    start = end;
   }
 }
 
@@ -28,7 +28,25 @@ class Partition {
   // [start, end) will belong to the same server, but key 'end' belongs to 
   // the next server or is greater than key_range_. By the way, the keys as
   // parameters should be sorted.
-  int32 NextEnding(std::vector<int32> keys, int32 start, int32& server_id);
+  int32 NextEnding(const int32* keys, int32 size, int32 start,
+                   int32& server_id);
+  int32 NextEnding(const std::vector<int32>& keys, int32 start,
+                   int32& server_id) {
+    return NextEnding(keys.data(), keys.size(), start, server_id);
+  }
+
+  // The keys in [start, end) of a sorted key array belong to server.
+  struct KeyRange {
+    int32 start;
+    int32 end;
+    int32 server;
+  };
+  // Split size sorted keys into the ranges of the servers, in the order of
+  // the keys, leaving out servers without keys. The keys before the first
+  // partition point wrap around to the last server, which then has two
+  // ranges. Each boundary is found by a binary search from the previous
+  // one, so the cost is O(server_num_ * log(size)).
+  void Split(const int32* keys, int32 size, std::vector<KeyRange>* ranges);
  private:
   // Number of keys in the system
   int32 key_range_;
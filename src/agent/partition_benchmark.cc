@@ -0,0 +1,89 @@
+// Copyright (c) 2019 The RPSCC Authors. All rights reserved.
+//
+// Benchmark for dividing the sorted keys of a push or pull among servers.
+// The loop the agent ran before, which called NextEnding with a fresh copy
+// of the keys for every server, is compared with Partition::Split.
+//
+// Usage: ./partition_benchmark --sizes=1000,10000000 --servers=32
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "src/agent/partition.h"
+
+DEFINE_string(sizes, "1000,100000,1000000,10000000",
+              "Comma separated numbers of keys to split.");
+DEFINE_int32(servers, 32, "Number of servers.");
+DEFINE_int32(key_range, 1 << 30, "Keys are drawn from [0, key_range).");
+DEFINE_int32(rounds, 5, "Number of splits for each size.");
+
+using rpscc::Partition;
+
+namespace {
+
+// Return the best time in ms of function.
+template <typename Function>
+double Measure(const Function& function) {
+  double best = 0;
+  for (int32 round = 0; round < FLAGS_rounds; round++) {
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    function();
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    if (best == 0 || seconds < best) best = seconds;
+  }
+  return best * 1e3;
+}
+
+void Run(Partition* partition, int32 size) {
+  std::mt19937 random(size);
+  std::uniform_int_distribution<int32> distribution(0, FLAGS_key_range - 1);
+  std::vector<int32> keys(size);
+  for (auto& key : keys) key = distribution(random);
+  std::sort(keys.begin(), keys.end());
+
+  int32 copy_ranges = 0;
+  double copy_ms = Measure([&] {
+    int32 start = 0, server_id;
+    copy_ranges = 0;
+    while (start < size) {
+      start = partition->NextEnding(
+          std::vector<int32>(keys.data(), keys.data() + size), start,
+          server_id);
+      copy_ranges++;
+    }
+  });
+  std::vector<Partition::KeyRange> ranges;
+  double split_ms = Measure([&] {
+    partition->Split(keys.data(), size, &ranges);
+  });
+  printf("size = %-10d copying %10.3f ms, split %8.4f ms (%d ranges)\n",
+         size, copy_ms, split_ms, static_cast<int32>(ranges.size()));
+  if (copy_ranges != ranges.size())
+    printf("The numbers of ranges differ: %d\n", copy_ranges);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  // The partition points are evenly spaced, as the master sets them.
+  std::vector<int32> part_vec(FLAGS_servers);
+  for (int32 i = 0; i < FLAGS_servers; i++)
+    part_vec[i] = static_cast<int64>(FLAGS_key_range) * i / FLAGS_servers;
+  Partition partition;
+  partition.Initialize(FLAGS_key_range, FLAGS_servers, part_vec);
+
+  std::stringstream sizes(FLAGS_sizes);
+  std::string size;
+  while (std::getline(sizes, size, ',')) Run(&partition, std::stoi(size));
+  return 0;
+}
@@ -44,5 +44,13 @@ int main() {
     start = end;
   }
 
+  vector<Partition::KeyRange> ranges;
+  p.Split(keys.data(), keys.size(), &ranges);
+  cout << "Split:" << endl;
+  for (auto range : ranges) {
+    cout << "start, end = " << range.start << ", " << range.end
+         << " server_id = " << range.server << endl;
+  }
+
   return 0;
 }
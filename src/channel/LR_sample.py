@@ -1,34 +1,15 @@
 import numpy as np
 from sklearn import linear_model
-import mmap
+from shared_memory import SharedMemory
 import contextlib
 import struct
 import os
 
 def transfer2Agent(values, keys, w):
-    w.seek(0)
-    w.write(struct.pack('i', len(values)))
-    for v in values:
-        w.write(struct.pack('f', v))
-    w.seek(4*(101)) #________________________________________________________
-    for k in keys:
-        w.write(struct.pack('i', k))
+    w.write(values, keys)
 
 def readFromAgent(m):
-    m.seek(0)
-    c = m.read(4)
-    sz = struct.unpack('i', c)[0]
-    coef = []
-    keys = []
-    for i in range(sz):
-        c = m.read(4)
-        coef.append(struct.unpack('f', c)[0])
-    for i in range(100-sz):
-        c = m.read(4)
-    for i in range(sz):
-        c = m.read(4)
-        keys.append(struct.unpack('i', c)[0])
-    return coef, keys
+    return m.read()
 if __name__ == '__main__':
 
     read_fd = os.open('/dev/shm/test_sharedMemory_sample1', os.O_RDWR | os.O_SYNC | os.O_CREAT)
@@ -39,8 +20,8 @@ if __name__ == '__main__':
     read_fifo = os.open(read_fifo_path, os.O_SYNC | os.O_CREAT | os.O_RDWR)
     write_fifo = os.open(write_fifo_path, os.O_SYNC | os.O_CREAT | os.O_RDWR)
 
-    m = mmap.mmap(read_fd, 804, access=mmap.ACCESS_READ)
-    w = mmap.mmap(write_fd, 804, mmap.MAP_SHARED, mmap.PROT_WRITE)
+    m = SharedMemory(read_fd)
+    w = SharedMemory(write_fd)
 
     # start of compute
     n_samples, n_features = 1000, 5
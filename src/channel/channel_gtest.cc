@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace rpscc;
@@ -67,8 +68,8 @@ TEST(ChannelTest, SharedMemory) {
     shmstruct *data = read_mem.Read();
     cout << "read complete." << endl;
     EXPECT_EQ(data->size, 1);
-    EXPECT_EQ(data->keys[0], 1111);
-    EXPECT_EQ(data->values[0], 13.5);
+    EXPECT_EQ(data->keys()[0], 1111);
+    EXPECT_EQ(data->values()[0], 13.5);
   } else {
     sleep(1);
     Fifo fifo_writer;
@@ -78,11 +79,9 @@ TEST(ChannelTest, SharedMemory) {
     SharedMemory write_mem;
     write_mem.Initialize(ipc_name_in.c_str());
 
-    shmstruct store_data;
-    store_data.values[0] = 13.5;
-    store_data.keys[0] = 1111L;
-    store_data.size = 1;
-    write_mem.Write(&store_data);
+    int32 store_key = 1111;
+    float32 store_value = 13.5;
+    write_mem.Write(&store_key, &store_value, 1);
     fifo_writer.Signal(1);
     cout << "write complete." << endl;
   }
@@ -105,15 +104,13 @@ TEST(ChannelTest, ChannelTestWithPython) {
   SharedMemory read_mem, write_mem;
   read_mem.Initialize(ipc_name2.c_str());
   write_mem.Initialize(ipc_name1.c_str());
-  shmstruct store_data;
-  store_data.size = 100;
-  memset(store_data.values, 0, sizeof store_data.values);
-  memset(store_data.keys, 0, sizeof store_data.keys);
+  vector<int32> store_keys(100);
+  vector<float32> store_values(100);
   for(int i=0; i<100; i++) {
-    store_data.values[i] = i+0.5;
-    store_data.keys[i] = i;
+    store_values[i] = i+0.5;
+    store_keys[i] = i;
   }
-  write_mem.Write(&store_data);
+  write_mem.Write(store_keys.data(), store_values.data(), 100);
   fifo_write.Open();
   fifo_write.Signal(1);
   fifo_read.Open();
@@ -122,8 +119,8 @@ TEST(ChannelTest, ChannelTestWithPython) {
   shmstruct* data_read = read_mem.Read();
   EXPECT_EQ(data_read->size, 100);
   for(int i=0; i<100; i++) {
-    EXPECT_EQ(data_read->values[i], i+1.5);
-    EXPECT_EQ(data_read->keys[i], i+1);
+    EXPECT_EQ(data_read->values()[i], i+1.5);
+    EXPECT_EQ(data_read->keys()[i], i+1);
   }
   exit(0);
 }
@@ -135,13 +132,6 @@ TEST(ChannelTest, LinearRegressionTest) {
   string rf_name = "/tmp/lr_r_fifo";
   string shm_w_name = "/shm_w_name";
   string shm_r_name = "/shm_r_name";
-  int32 fd = shm_open(shm_w_name.c_str(), O_RDWR | O_CREAT, FILE_MODE);
-  ftruncate(fd, sizeof(struct shmstruct));
-  close(fd);
-  fd = shm_open(shm_r_name.c_str(), O_RDWR | O_CREAT, FILE_MODE);
-  ftruncate(fd, sizeof(struct shmstruct));
-  close(fd);
-
   mkfifo(wf_name.c_str(), 0777);
   mkfifo(rf_name.c_str(), 0777);
   Fifo wf, rf;
@@ -154,20 +144,19 @@ TEST(ChannelTest, LinearRegressionTest) {
   wf.Open(); rf.Open();
   double b = 0, m = 0;
   int32 sig;
-  shmstruct parameters, grad;
+  int32 keys[2] = {0, 1};
+  float32 parameters[2];
+  shmstruct* grad;
   float32 learning_rate = 0.0001;
   while(true) {
     sig = rf.Wait();
     if(sig == 0) {
-      parameters.size = 2;
-      parameters.keys[0] = 0;
-      parameters.keys[1] = 1;
-      parameters.values[0] = 0;
-      parameters.values[1] = 0;
-      wm.Write(&parameters);
+      parameters[0] = 0;
+      parameters[1] = 0;
+      wm.Write(keys, parameters, 2);
       wf.Signal(2);
     } else if(sig == 1) {
-      grad = *rm.Read();
+      grad = rm.Read();
       // cout << "c++" << endl;
       // co      //   cout << grad.keys[i] << endl;
       // }ut << grad.size << endl;
@@ -175,14 +164,11 @@ TEST(ChannelTest, LinearRegressionTest) {
       //   cout << grad.values[i] << endl;
       //   cout << grad.keys[i] << endl;
       // }x
-      b = b - (learning_rate * grad.values[0]);
-      m = m - (learning_rate * grad.values[1]);
-      parameters.size = 2;
-      parameters.keys[0] = 0;
-      parameters.keys[1] = 1;
-      parameters.values[0] = b;
-      parameters.values[1] = m;
-      wm.Write(&parameters);
+      b = b - (learning_rate * grad->values()[0]);
+      m = m - (learning_rate * grad->values()[1]);
+      parameters[0] = b;
+      parameters[1] = m;
+      wm.Write(keys, parameters, 2);
       wf.Signal(2);
     } else {
       break;
@@ -33,19 +33,11 @@ int main() {
     shmstruct* data_read = read_mem.Read();
     std::cout << data_read->size << std::endl;
     for(int i=0; i<data_read->size; i++) {
-      std::cout << data_read->keys[i] << " " << data_read->values[i] << std::endl;
+      std::cout << data_read->keys()[i] << " " << data_read->values()[i] << std::endl;
     }
-    shmstruct store_data;
-    store_data.size = data_read->size;
     // should be the values pulled from server to write to
     // write_mem other than data_read
-    memset(store_data.values, 0, sizeof store_data.values);
-    memset(store_data.keys, 0, sizeof store_data.keys);
-    for(int i=0; i<data_read->size; i++) {
-      store_data.values[i] = data_read->values[i];
-      store_data.keys[i] = data_read->keys[i];
-    }
-    write_mem.Write(&store_data);
+    write_mem.Write(data_read);
     fifo_write.Signal(1);
   }
   exit(0);
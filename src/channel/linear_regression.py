@@ -3,7 +3,7 @@
 
 import sys
 import os
-import mmap
+from shared_memory import SharedMemory
 import struct
 import json
 import time
@@ -16,31 +16,12 @@ from sklearn.metrics import mean_squared_error
 
 def read_from_agent(m):
     """Read from shared memory."""
-    m.seek(0)
-    c = m.read(4)
-    sz = struct.unpack('i', c)[0]
-    coef = []
-    keys = []
-    for i in range(sz):
-        c = m.read(4)
-        coef.append(struct.unpack('f', c)[0])
-    for i in range(100-sz):
-        c = m.read(4)
-    for i in range(sz):
-        c = m.read(4)
-        keys.append(struct.unpack('i', c)[0])
+    coef, keys = m.read()
     return np.asarray(coef), np.asarray(keys)
 
 def transfer_to_agent(values, keys, w):
     """Write to shared memory."""
-    w.seek(0)
-    w.write(struct.pack('i', len(keys)))
-    # print values
-    for v in values:
-        w.write(struct.pack('f', v))
-    w.seek(4*(101)) #________________________________________________________
-    for k in keys:
-        w.write(struct.pack('i', k))
+    w.write(values, keys)
 
 def load_data(file_path):
     """Loading the data from file."""
@@ -137,8 +118,8 @@ if __name__ == '__main__':
 
         read_fifo = os.open(read_fifo_path, os.O_SYNC | os.O_RDWR)
         write_fifo = os.open(write_fifo_path, os.O_SYNC | os.O_RDWR)
-        w = mmap.mmap(write_fd, 804, mmap.MAP_SHARED, mmap.PROT_WRITE)
-        m = mmap.mmap(read_fd, 804, access=mmap.ACCESS_READ)
+        w = SharedMemory(write_fd)
+        m = SharedMemory(read_fd)
 
     train_X, train_y = load_data(train_file)
     eval_X, eval_y = load_data(eval_file)
@@ -1,8 +1,11 @@
 // Copyright (c) 2018 The RPSCC Authors. All rights reserved.
 // Author : Zhen Lee (lz.askey@gmail.com)
 
+#include <sys/stat.h>
+
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 
 #include "src/channel/shared_memory.h"
 
@@ -10,29 +13,109 @@ namespace rpscc {
 
   //char* px_ipc_name(const char* name);
 
-void SharedMemory::Initialize(const char *ipc_name) {
+bool SharedMemory::Initialize(const char *ipc_name, int32 capacity) {
 //  initialize the shared memory
-  int fd = shm_open(ipc_name,
-      O_RDWR | O_CREAT, FILE_MODE);
-  ftruncate(fd, sizeof(struct shmstruct));
-  shared_data_ = (struct shmstruct*)mmap(NULL, sizeof(struct shmstruct),
-      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  close(fd);
+  Finalize();
+  fd_ = shm_open(ipc_name, O_RDWR | O_CREAT, FILE_MODE);
+  if (fd_ < 0) {
+    std::cerr << "Failed to open shared memory " << ipc_name << std::endl;
+    return false;
+  }
+  struct stat st;
+  fstat(fd_, &st);
+  size_t bytes = st.st_size;
+  if (bytes < sizeof(shmstruct)) {
+    // A new segment.
+    bytes = shmstruct::Bytes(capacity);
+    if (ftruncate(fd_, bytes) != 0 || !Map(bytes)) return false;
+    shared_data_->size = 0;
+    shared_data_->capacity = capacity;
+    return true;
+  }
+  if (!Map(bytes)) return false;
+  // Drop a header which does not fit the segment.
+  if (shared_data_->capacity < 0 ||
+      shmstruct::Bytes(shared_data_->capacity) > bytes) {
+    shared_data_->size = 0;
+    shared_data_->capacity = (bytes - sizeof(shmstruct)) /
+                             (sizeof(float32) + sizeof(int32));
+  }
+  return Reserve(capacity);
+}
+
+void SharedMemory::Finalize() {
+  if (shared_data_ != NULL) munmap(shared_data_, mapped_bytes_);
+  if (fd_ >= 0) close(fd_);
+  shared_data_ = NULL;
+  mapped_bytes_ = 0;
+  fd_ = -1;
+}
+
+bool SharedMemory::Map(size_t bytes) {
+  void* data;
+#ifdef __linux__
+  if (shared_data_ != NULL) {
+    data = mremap(shared_data_, mapped_bytes_, bytes, MREMAP_MAYMOVE);
+  } else {
+    data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  }
+#else
+  if (shared_data_ != NULL) munmap(shared_data_, mapped_bytes_);
+  data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+#endif
+  if (data == MAP_FAILED) {
+    std::cerr << "Failed to map " << bytes << " bytes of shared memory"
+              << std::endl;
+    shared_data_ = NULL;
+    mapped_bytes_ = 0;
+    return false;
+  }
+  shared_data_ = reinterpret_cast<shmstruct*>(data);
+  mapped_bytes_ = bytes;
+  return true;
+}
+
+bool SharedMemory::Reserve(int32 capacity) {
+  int32 old_capacity = Read()->capacity;
+  if (capacity <= old_capacity) return true;
+  // Grow geometrically, so that a worker with a slowly growing batch does
+  // not remap in every iteration.
+  capacity = std::max<int64>(capacity, 2 * static_cast<int64>(old_capacity));
+  size_t bytes = shmstruct::Bytes(capacity);
+  if (ftruncate(fd_, bytes) != 0 || !Map(bytes)) return false;
+  // The keys follow the values, so they move with the capacity.
+  int32* old_keys = shared_data_->keys();
+  shared_data_->capacity = capacity;
+  memmove(shared_data_->keys(), old_keys,
+          std::max(shared_data_->size, 0) * sizeof(int32));
+  return true;
 }
 
 shmstruct* SharedMemory::Read() {
   // read
-//  simple return the shared memory ptr.
+//  simple return the shared memory ptr, after following the other side's
+//  growth.
+  if (shmstruct::Bytes(shared_data_->capacity) > mapped_bytes_) {
+    struct stat st;
+    fstat(fd_, &st);
+    Map(st.st_size);
+  }
   return shared_data_;
 }
 
-void SharedMemory::Write(shmstruct* data) {
+bool SharedMemory::Write(const int32* keys, const float32* values,
+                         int32 size) {
 //  use copy function to copy the data.
-  std::copy(std::begin(data->values), std::end(data->values),
-      std::begin(shared_data_->values));
-  std::copy(std::begin(data->keys), std::end(data->keys),
-      std::begin(shared_data_->keys));
-  shared_data_->size = data->size;
+  if (!Reserve(size)) return false;
+  shared_data_->size = 0;
+  std::copy(values, values + size, shared_data_->values());
+  std::copy(keys, keys + size, shared_data_->keys());
+  shared_data_->size = size;
+  return true;
+}
+
+bool SharedMemory::Write(shmstruct* data) {
+  return Write(data->keys(), data->values(), data->size);
 }
 
 // this function target to get a px_ipc_name more capable
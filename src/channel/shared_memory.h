@@ -17,28 +17,57 @@
 
 namespace rpscc {
 
-// the struct to store data;
+// The header of a shared memory segment. In the segment it is followed by
+//   float32 values[capacity];
+//   int32 keys[capacity];
+// The segment grows when a writer needs more room, and the reader maps the
+// new size in its next Read(). The worker side in python is in
+// shared_memory.py.
 struct shmstruct {
   int32 size;
-  float32 values[100];
-  int32 keys[100];
-//  int64 keys;
-//  float32 values;
+  int32 capacity;
+
+  float32* values() { return reinterpret_cast<float32*>(this + 1); }
+  int32* keys() { return reinterpret_cast<int32*>(values() + capacity); }
+  // Bytes of a segment with room for capacity pairs.
+  static size_t Bytes(int32 capacity) {
+    return sizeof(shmstruct) +
+           static_cast<size_t>(capacity) * (sizeof(float32) + sizeof(int32));
+  }
 };
 
 // a shared memory with fifo for write and read control.
 class SharedMemory {
  public:
-  SharedMemory() {}
-  ~SharedMemory() {}
+  static const int32 kDefaultCapacity = 100;
+
+  SharedMemory() : fd_(-1), shared_data_(NULL), mapped_bytes_(0) {}
+  ~SharedMemory() { Finalize(); }
+
+  // Open or create the segment ipc_name with room for at least capacity
+  // pairs. A segment created by the other side keeps its content.
+  bool Initialize(const char* ipc_name, int32 capacity = kDefaultCapacity);
+  void Finalize();
 
-  void Initialize(const char* ipc_name_read);
+  // Make room for at least capacity pairs, keeping the pairs in the
+  // segment. The pointer returned by Read() may change.
+  bool Reserve(int32 capacity);
 
-  void Write(shmstruct* data);
+  // Copy size pairs into the segment, growing it if needed.
+  bool Write(const int32* keys, const float32* values, int32 size);
+  bool Write(shmstruct* data);
 
+  // Return the segment, which is remapped first if the other side has
+  // grown it.
   shmstruct* Read();
+
  private:
+  // Map the first bytes of the segment, replacing the current mapping.
+  bool Map(size_t bytes);
+
+  int fd_;
   struct shmstruct* shared_data_;
+  size_t mapped_bytes_;
 };
 
 }
@@ -0,0 +1,70 @@
+# Copyright (c) 2019 The RPSCC Authors. All rights reserved.
+#
+# Worker side of the shared memory channel, see shared_memory.h.
+# A segment is laid out as
+#   int32 size, int32 capacity, float32 values[capacity], int32 keys[capacity]
+# and grows when a writer needs more room, so a reader maps the size of the
+# file again when it finds a larger capacity.
+
+import mmap
+import os
+import struct
+
+HEADER = struct.Struct('ii')
+
+
+class SharedMemory(object):
+
+    def __init__(self, fd, capacity=100):
+        """fd is a segment in /dev/shm opened with os.O_RDWR."""
+        self.fd = fd
+        self.m = None
+        self.length = 0
+        if os.fstat(self.fd).st_size < HEADER.size:
+            os.ftruncate(self.fd, HEADER.size + 8 * capacity)
+            self._map()
+            HEADER.pack_into(self.m, 0, 0, capacity)
+        else:
+            self._map()
+
+    def _map(self):
+        length = os.fstat(self.fd).st_size
+        if length != self.length:
+            if self.m is not None:
+                self.m.close()
+            self.m = mmap.mmap(self.fd, length, mmap.MAP_SHARED,
+                               mmap.PROT_READ | mmap.PROT_WRITE)
+            self.length = length
+
+    def _header(self):
+        size, capacity = HEADER.unpack_from(self.m, 0)
+        if HEADER.size + 8 * capacity > self.length:
+            self._map()
+        return size, capacity
+
+    def read(self):
+        """Return the values and keys in the segment."""
+        size, capacity = self._header()
+        values = list(struct.unpack_from('%df' % size, self.m, HEADER.size))
+        keys = list(struct.unpack_from('%di' % size, self.m,
+                                       HEADER.size + 4 * capacity))
+        return values, keys
+
+    def write(self, values, keys):
+        """Write keys and their values, missing values are written as 0."""
+        size = len(keys)
+        values = list(values) + [0.0] * (size - len(values))
+        _, capacity = self._header()
+        if size > capacity:
+            capacity = max(size, 2 * capacity)
+            os.ftruncate(self.fd, HEADER.size + 8 * capacity)
+            self._map()
+        HEADER.pack_into(self.m, 0, 0, capacity)
+        struct.pack_into('%df' % size, self.m, HEADER.size, *values[:size])
+        struct.pack_into('%di' % size, self.m, HEADER.size + 4 * capacity,
+                         *keys)
+        HEADER.pack_into(self.m, 0, size, capacity)
+
+    def close(self):
+        self.m.close()
+        os.close(self.fd)
@@ -19,25 +19,20 @@ TEST(SharedMemory, PythonCpp) {
   Py_SetProgramName(program);  /* optional but recommended */
   Py_Initialize();
   PyRun_SimpleString("import os\n"
-                     "import mmap\n"
+                     "import sys\n"
+                     "sys.path.append('.')\n"
+                     "from shared_memory import SharedMemory\n"
                      "write_fd = os.open('/dev/shm/python_cpp', os.O_RDWR | os.O_SYNC)\n"
-                     "w = mmap.mmap(write_fd, 804, mmap.MAP_SHARED, mmap.PROT_WRITE)\n"
-                     "import struct\n"
-                     "w.seek(0)\n"
-                     "w.write(struct.pack('i', 1))\n"
-                     "for i in range(90):\n"
-                     "    w.write(struct.pack('f', i))\n"
-                     "w.seek(101 * 4)\n"
-                     "for i in range(90):\n"
-                     "    w.write(struct.pack('i', i))\n"
+                     "w = SharedMemory(write_fd)\n"
+                     "w.write([float(i) for i in range(90)], list(range(90)))\n"
                      );
   PyMem_RawFree(program);
   rpscc::shmstruct* data = reader.Read();
-  EXPECT_EQ(data->size, 1);
+  EXPECT_EQ(data->size, 90);
   for (int i = 0; i < 90; ++ i)
-    EXPECT_FLOAT_EQ(data->values[i], i);
+    EXPECT_FLOAT_EQ(data->values()[i], i);
   for (int i = 0; i < 90; ++ i)
-    EXPECT_EQ(data->keys[i], i);
+    EXPECT_EQ(data->keys()[i], i);
 }
 
 
@@ -2,35 +2,15 @@
 from numpy import *
 import os
 import struct
-import mmap
+from shared_memory import SharedMemory
 
 # read from shared memory
 def readFromAgent(m):
-    m.seek(0)
-    c = m.read(4)
-    sz = struct.unpack('i', c)[0]
-    coef = []
-    keys = []
-    for i in range(sz):
-        c = m.read(4)
-        coef.append(struct.unpack('f', c)[0])
-    for i in range(100-sz):
-        c = m.read(4)
-    for i in range(sz):
-        c = m.read(4)
-        keys.append(struct.unpack('i', c)[0])
-    return coef, keys
+    return m.read()
 
 # write to shared memory
 def transfer2Agent(values, keys, w):
-    w.seek(0)
-    w.write(struct.pack('i', len(values)))
-    # print values
-    for v in values:
-        w.write(struct.pack('f', v))
-    w.seek(4*(101)) #________________________________________________________
-    for k in keys:
-        w.write(struct.pack('i', k))
+    w.write(values, keys)
 
 # minimize the "sum of squared errors". This is how we calculate and correct our error
 def compute_error_for_line_given_points(b, m, points):
@@ -113,7 +93,7 @@ if __name__ == "__main__":
     read_fifo = os.open(read_fifo_path, os.O_SYNC | os.O_CREAT | os.O_RDWR)
     write_fifo = os.open(write_fifo_path, os.O_SYNC | os.O_CREAT | os.O_RDWR)
 
-    m = mmap.mmap(read_fd, 804, access=mmap.ACCESS_READ)
-    w = mmap.mmap(write_fd, 804, mmap.MAP_SHARED, mmap.PROT_WRITE)
+    m = SharedMemory(read_fd)
+    w = SharedMemory(write_fd)
 
     run(read_fifo, write_fifo, m, w)
@@ -20,7 +20,8 @@ class Communicator {
   virtual void Finalize() = 0;
 
   // Initialize the communicator
-  // The buffer_size is used in receiving.
+  // The buffer_size is a hint for the implementations that receive into
+  // fixed size buffers.
   // Return:
   // true : Init successfully
   // false : Init failed
@@ -34,6 +35,8 @@ class Communicator {
   virtual int32 Send(int32 dst_id, const char* const message,
                      int32 len) = 0;
   virtual int32 Send(int32 dst_id, const std::string& message) = 0;
+  // Send a message whose buffer can be taken over by the communicator.
+  virtual int32 Send(int32 dst_id, std::string&& message) = 0;
   // Receive a message from any node
   // Return:
   // > 0 : bytes received
@@ -1,6 +1,8 @@
 // Copyright 2018 The RPSCC Authors. All Rights Reserved.
 // Author : Chenbin Zhang (zcbin@pku.edu.cn)
 
+#include <algorithm>
+
 #include <src/util/logging.h>
 #include "src/communication/fifo_ring.h"
 
@@ -11,22 +13,19 @@ namespace rpscc {
     consume_point_ = 0;
     sem_init(&empty_sem_, 0, ring_size_);
     sem_init(&full_sem_, 0, 0);
-    ring_ = new char*[ring_size_];
-    memset(ring_, 0, sizeof(ring_));
-    data_sizes_ = new int[ring_size_];
-    memset(data_sizes_, 0, sizeof(data_sizes_));
+    ring_ = new std::string[ring_size_];
+    tags_ = new int32[ring_size_];
+    memset(tags_, 0, sizeof(int32) * ring_size_);
     return true;
   }
   void FifoRing::Finalize() {
     sem_destroy(&empty_sem_);
     sem_destroy(&full_sem_);
-    delete ring_;
-    delete data_sizes_;
+    delete[] ring_;
+    delete[] tags_;
     // Maybe I will add empty_sem_ processing method in the future
   }
-  int32 FifoRing::Add(const char* const message, int32 len) {
-    sem_wait(&empty_sem_);
-
+  int32 FifoRing::NextProduceIndex() {
     int32_t index = -1;
     {
       std::lock_guard<std::mutex> guard(produce_mutex);
@@ -34,20 +33,10 @@ namespace rpscc {
       produce_point_++;
       produce_point_ %= ring_size_;
     }
-
     CHECK_NE(index, -1) << "Fifo add error." << std::endl;
-
-    ring_[index] = new char[len];
-    memcpy(ring_[index], message, len);
-    data_sizes_[index] = len;
-
-    sem_post(&full_sem_);
-
-    return len;
+    return index;
   }
-  int32 FifoRing::Fetch(char* message, const int32 max_size) {
-    sem_wait(&full_sem_);
-
+  int32 FifoRing::NextConsumeIndex() {
     int32_t index = -1;
     {
       std::lock_guard<std::mutex> guard(consume_mutex);
@@ -56,18 +45,68 @@ namespace rpscc {
       consume_point_ %= ring_size_;
     }
     CHECK_NE(index, -1) << "Fetch error." << std::endl;
+    return index;
+  }
+  int32 FifoRing::Add(const char* const message, int32 len) {
+    sem_wait(&empty_sem_);
+
+    int32 index = NextProduceIndex();
+    ring_[index].assign(message, len);
+    tags_[index] = 0;
+
+    sem_post(&full_sem_);
+
+    return len;
+  }
+  int32 FifoRing::Add(std::string* message, int32 tag) {
+    sem_wait(&empty_sem_);
+
+    int32 index = NextProduceIndex();
+    ring_[index].swap(*message);
+    tags_[index] = tag;
+    int32 len = ring_[index].size();
 
-    if (ring_[index] == NULL) {
+    sem_post(&full_sem_);
+
+    return len;
+  }
+  int32 FifoRing::Fetch(char* message, const int32 max_size) {
+    sem_wait(&full_sem_);
+    return TakeSlot(message, max_size);
+  }
+  int32 FifoRing::TryFetch(char* message, const int32 max_size) {
+    if (sem_trywait(&full_sem_) != 0) {
       return -1;
     }
-    int32 len = data_sizes_[index];
-    memcpy(message, ring_[index], len);
-    delete[] ring_[index];
-    ring_[index] = nullptr;
-    
+    return TakeSlot(message, max_size);
+  }
+  int32 FifoRing::Fetch(std::string* message, int32* tag) {
+    sem_wait(&full_sem_);
+    return TakeSlot(message, tag);
+  }
+  int32 FifoRing::TryFetch(std::string* message, int32* tag) {
+    if (sem_trywait(&full_sem_) != 0) {
+      return -1;
+    }
+    return TakeSlot(message, tag);
+  }
+  int32 FifoRing::TakeSlot(char* message, const int32 max_size) {
+    int32 index = NextConsumeIndex();
+    int32 len = std::min<int32>(ring_[index].size(), max_size);
+    memcpy(message, ring_[index].data(), len);
+    ring_[index].clear();
+
     sem_post(&empty_sem_);
     return len;
   }
+  int32 FifoRing::TakeSlot(std::string* message, int32* tag) {
+    int32 index = NextConsumeIndex();
+    message->swap(ring_[index]);
+    if (tag != NULL) *tag = tags_[index];
+    ring_[index].clear();
 
-}  // namespace rpscc
+    sem_post(&empty_sem_);
+    return message->size();
+  }
 
+}  // namespace rpscc
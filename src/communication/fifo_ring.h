@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <mutex>
+#include <string>
 
 #include "src/util/common.h"
 
@@ -17,6 +18,9 @@ namespace rpscc {
 // FifoRing is an implemention of round-robin queue.
 // This ring now support one producer and one consumer to work at the same
 // time, and it is thread-safe.
+// Every slot is a std::string with an integer tag. Messages passed as
+// std::string are swapped in and out of the slots, so a message of any size
+// goes through the ring without being copied.
 class FifoRing {
  public:
   FifoRing() {}
@@ -29,14 +33,30 @@ class FifoRing {
   // or fetched.
   int32 Add(const char* const message, int32 len);
   int32 Fetch(char* message, const int32 max_size);
+  // Fetch a message only if there is one in the ring, return -1 otherwise.
+  int32 TryFetch(char* message, const int32 max_size);
+  // Move the content of message into the ring, message is left with the
+  // content of a consumed slot. The tag is carried along with the message.
+  int32 Add(std::string* message, int32 tag = 0);
+  // Move a message out of the ring, and store its tag if tag is not NULL.
+  int32 Fetch(std::string* message, int32* tag = NULL);
+  int32 TryFetch(std::string* message, int32* tag = NULL);
 
  private:
+  // Reserve the next slot for producer or consumer.
+  int32 NextProduceIndex();
+  int32 NextConsumeIndex();
+  // Take the message out of the next slot, the caller must have acquired
+  // full_sem_.
+  int32 TakeSlot(char* message, const int32 max_size);
+  int32 TakeSlot(std::string* message, int32* tag);
+
   // Size of the ring.
   int32 ring_size_;
   // The body of the ring
-  char** ring_;
-  // data_sizes_ stores all data blocks' size information.
-  int* data_sizes_;
+  std::string* ring_;
+  // tags_ stores the tag of every slot.
+  int32* tags_;
   // These pointers point to the place where producer or consumer start to
   // produce or consume data in the ring.
   int32 produce_point_;
@@ -56,4 +76,3 @@ class FifoRing {
 }  // namespace rpscc
 
 #endif  // SRC_COMMUNICATION_FIFO_RING_H_
-
@@ -0,0 +1,76 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+//
+// Benchmark for the message rings used by ZmqCommunicator.
+// Producers add messages to a ring while one consumer fetches them, and the
+// number of messages passed per second is reported for the semaphore based
+// FifoRing and for the lock-free rings under 1, 2 and 4 producers.
+//
+// Usage: ./fifo_ring_benchmark --messages=1000000 --message_size=64
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "src/communication/fifo_ring.h"
+#include "src/communication/lock_free_ring.h"
+
+DEFINE_int32(messages, 1000000, "Number of messages in each test.");
+DEFINE_int32(message_size, 64, "Bytes of each message.");
+DEFINE_int32(ring_size, 64, "Number of slots in the ring.");
+
+using rpscc::FifoRing;
+using rpscc::MpscRing;
+using rpscc::SpscRing;
+
+namespace {
+
+template <typename Ring>
+void Run(const char* name, int32 producers) {
+  Ring ring;
+  ring.Initialize(FLAGS_ring_size);
+  int32 per_producer = FLAGS_messages / producers;
+  std::string payload(FLAGS_message_size, 'x');
+
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int32 p = 0; p < producers; p++) {
+    threads.emplace_back([&ring, &payload, per_producer, p]() {
+      std::string message;
+      for (int32 i = 0; i < per_producer; i++) {
+        message.assign(payload);
+        ring.Add(&message, p);
+      }
+    });
+  }
+  std::string message;
+  int32 tag;
+  for (int32 i = 0; i < per_producer * producers; i++) {
+    ring.Fetch(&message, &tag);
+  }
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+  for (auto& thread : threads) thread.join();
+  ring.Finalize();
+
+  printf("%-10s producers = %d : %.0f ops/sec\n", name, producers,
+         per_producer * producers / seconds);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  Run<FifoRing>("FifoRing", 1);
+  Run<SpscRing>("SpscRing", 1);
+  Run<MpscRing>("MpscRing", 1);
+  for (int32 producers : {2, 4}) {
+    Run<FifoRing>("FifoRing", producers);
+    Run<MpscRing>("MpscRing", producers);
+  }
+  return 0;
+}
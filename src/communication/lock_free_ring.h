@@ -0,0 +1,276 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+//
+// A bounded lock-free ring for passing messages between threads.
+
+#ifndef SRC_COMMUNICATION_LOCK_FREE_RING_H_
+#define SRC_COMMUNICATION_LOCK_FREE_RING_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// LockFreeRing is a bounded queue with one consumer and one
+// (kMultiProducer = false) or many (kMultiProducer = true) producers.
+// It follows the design of Dmitry Vyukov's bounded MPMC queue: every slot
+// has a sequence number telling whether it is free for the producer of a
+// given round or filled for the consumer, so producers and the consumer
+// never touch the same cache line unless the ring is nearly empty or full.
+// The slots are allocated once in Initialize, and messages are swapped in and
+// out of them, so nothing is allocated or copied while the ring is running.
+// Add and Fetch spin for a short while and then sleep on a condition
+// variable. The condition variable is only touched when a thread really
+// waits, so the uncontended path takes no lock.
+// It has the same interface as FifoRing.
+template <bool kMultiProducer>
+class LockFreeRing {
+ public:
+  LockFreeRing() : slots_(NULL) {}
+  ~LockFreeRing() { Finalize(); }
+  // To initialize the ring, ring_size is rounded up to a power of two.
+  bool Initialize(int32 ring_size);
+  // To finalize the ring
+  void Finalize();
+  // Add or Fetch a message from the ring, return the size of message added
+  // or fetched.
+  int32 Add(const char* const message, int32 len);
+  int32 Fetch(char* message, const int32 max_size);
+  // Fetch a message only if there is one in the ring, return -1 otherwise.
+  int32 TryFetch(char* message, const int32 max_size);
+  // Move the content of message into the ring, message is left with the
+  // content of a consumed slot. The tag is carried along with the message.
+  int32 Add(std::string* message, int32 tag = 0);
+  // Add a message only if there is space in the ring, return -1 otherwise.
+  int32 TryAdd(std::string* message, int32 tag = 0);
+  // Move a message out of the ring, and store its tag if tag is not NULL.
+  int32 Fetch(std::string* message, int32* tag = NULL);
+  int32 TryFetch(std::string* message, int32* tag = NULL);
+
+ private:
+  static const int32 kCacheLineSize = 64;
+  // Times to retry before a thread goes to sleep.
+  static const int32 kSpinCount = 128;
+
+  struct alignas(kCacheLineSize) Slot {
+    // Equals to the position of the slot's next producer when it is free,
+    // and to that position plus one when it is filled.
+    std::atomic<uint64_t> sequence;
+    int32 tag;
+    std::string message;
+  };
+
+  // Whether the consumer or a producer could make progress now.
+  bool Readable() const;
+  bool Writable() const;
+  // Wake up the threads waiting on the other side of the ring.
+  void NotifyConsumer();
+  void NotifyProducers();
+
+  Slot* slots_;
+  uint64_t mask_;
+  char padding0_[kCacheLineSize];
+  // Position of the next slot to produce, shared by the producers.
+  std::atomic<uint64_t> tail_;
+  char padding1_[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+  // Position of the next slot to consume, only used by the consumer.
+  uint64_t head_;
+  char padding2_[kCacheLineSize - sizeof(uint64_t)];
+  // Number of threads sleeping because the ring is empty or full.
+  std::atomic<int32> empty_waiters_;
+  std::atomic<int32> full_waiters_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+typedef LockFreeRing<false> SpscRing;
+typedef LockFreeRing<true> MpscRing;
+
+template <bool kMultiProducer>
+bool LockFreeRing<kMultiProducer>::Initialize(int32 ring_size) {
+  Finalize();
+  uint64_t capacity = 2;
+  while (capacity < static_cast<uint64_t>(ring_size)) capacity <<= 1;
+  void* memory = NULL;
+  if (posix_memalign(&memory, kCacheLineSize, capacity * sizeof(Slot)) != 0) {
+    return false;
+  }
+  slots_ = reinterpret_cast<Slot*>(memory);
+  for (uint64_t i = 0; i < capacity; i++) {
+    new (&slots_[i]) Slot();
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+    slots_[i].tag = 0;
+  }
+  mask_ = capacity - 1;
+  tail_.store(0, std::memory_order_relaxed);
+  head_ = 0;
+  empty_waiters_.store(0, std::memory_order_relaxed);
+  full_waiters_.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  return true;
+}
+
+template <bool kMultiProducer>
+void LockFreeRing<kMultiProducer>::Finalize() {
+  if (slots_ == NULL) return;
+  for (uint64_t i = 0; i <= mask_; i++) slots_[i].~Slot();
+  free(slots_);
+  slots_ = NULL;
+}
+
+template <bool kMultiProducer>
+int32 LockFreeRing<kMultiProducer>::TryAdd(std::string* message, int32 tag) {
+  uint64_t pos = tail_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[pos & mask_];
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(sequence - pos);
+    if (diff < 0) return -1;  // The ring is full.
+    if (!kMultiProducer) {
+      tail_.store(pos + 1, std::memory_order_relaxed);
+      break;
+    }
+    if (diff == 0 && tail_.compare_exchange_weak(
+            pos, pos + 1, std::memory_order_relaxed)) {
+      break;
+    }
+    // Another producer has taken the slot, and pos has been reloaded by
+    // compare_exchange_weak unless the slot looked filled.
+    if (diff > 0) pos = tail_.load(std::memory_order_relaxed);
+  }
+  slot->message.swap(*message);
+  slot->tag = tag;
+  int32 len = slot->message.size();
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  NotifyConsumer();
+  return len;
+}
+
+template <bool kMultiProducer>
+int32 LockFreeRing<kMultiProducer>::TryFetch(std::string* message,
+                                             int32* tag) {
+  Slot* slot = &slots_[head_ & mask_];
+  if (slot->sequence.load(std::memory_order_acquire) != head_ + 1) {
+    return -1;  // The ring is empty.
+  }
+  message->swap(slot->message);
+  if (tag != NULL) *tag = slot->tag;
+  slot->message.clear();
+  // The slot is free for the producer of the next round.
+  slot->sequence.store(head_ + mask_ + 1, std::memory_order_release);
+  head_++;
+  NotifyProducers();
+  return message->size();
+}
+
+template <bool kMultiProducer>
+int32 LockFreeRing<kMultiProducer>::Add(std::string* message, int32 tag) {
+  int32 len;
+  for (int32 i = 0; i < kSpinCount; i++) {
+    if ((len = TryAdd(message, tag)) >= 0) return len;
+  }
+  while ((len = TryAdd(message, tag)) < 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    full_waiters_.fetch_add(1, std::memory_order_relaxed);
+    // Pairs with the fence in NotifyProducers.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    not_full_.wait(lock, [this]() { return Writable(); });
+    full_waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return len;
+}
+
+template <bool kMultiProducer>
+int32 LockFreeRing<kMultiProducer>::Fetch(std::string* message, int32* tag) {
+  int32 len;
+  for (int32 i = 0; i < kSpinCount; i++) {
+    if ((len = TryFetch(message, tag)) >= 0) return len;
+  }
+  while ((len = TryFetch(message, tag)) < 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    empty_waiters_.fetch_add(1, std::memory_order_relaxed);
+    // Pairs with the fence in NotifyConsumer.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    not_empty_.wait(lock, [this]() { return Readable(); });
+    empty_waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return len;
+}
+
+template <bool kMultiProducer>
+int32 LockFreeRing<kMultiProducer>::Add(const char* const message,
+                                        int32 len) {
+  std::string buffer(message, len);
+  return Add(&buffer);
+}
+
+template <bool kMultiProducer>
+int32 LockFreeRing<kMultiProducer>::Fetch(char* message,
+                                          const int32 max_size) {
+  std::string buffer;
+  Fetch(&buffer);
+  int32 len = std::min<int32>(buffer.size(), max_size);
+  memcpy(message, buffer.data(), len);
+  return len;
+}
+
+template <bool kMultiProducer>
+int32 LockFreeRing<kMultiProducer>::TryFetch(char* message,
+                                             const int32 max_size) {
+  std::string buffer;
+  if (TryFetch(&buffer) < 0) return -1;
+  int32 len = std::min<int32>(buffer.size(), max_size);
+  memcpy(message, buffer.data(), len);
+  return len;
+}
+
+template <bool kMultiProducer>
+bool LockFreeRing<kMultiProducer>::Readable() const {
+  return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) ==
+         head_ + 1;
+}
+
+template <bool kMultiProducer>
+bool LockFreeRing<kMultiProducer>::Writable() const {
+  uint64_t pos = tail_.load(std::memory_order_relaxed);
+  uint64_t sequence =
+      slots_[pos & mask_].sequence.load(std::memory_order_acquire);
+  return static_cast<int64_t>(sequence - pos) >= 0;
+}
+
+// A waiter increases the counter and then checks the ring, while the other
+// side updates the ring and then checks the counter. With a full fence on
+// both sides at least one of them sees the other, so a wake up is never lost.
+// The mutex is taken before notifying, so the waiter is either not yet
+// checking or already sleeping.
+template <bool kMultiProducer>
+void LockFreeRing<kMultiProducer>::NotifyConsumer() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (empty_waiters_.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    not_empty_.notify_all();
+  }
+}
+
+template <bool kMultiProducer>
+void LockFreeRing<kMultiProducer>::NotifyProducers() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (full_waiters_.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    not_full_.notify_all();
+  }
+}
+
+}  // namespace rpscc
+
+#endif  // SRC_COMMUNICATION_LOCK_FREE_RING_H_
@@ -0,0 +1,51 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/communication/lock_free_ring.h"
+
+using namespace rpscc;
+
+// This is a tester for lock_free_ring.
+// Four producers add numbered messages to a small ring, and the consumer
+// checks that every producer's messages arrive once and in order.
+int main() {
+  const int kProducers = 4;
+  const int kMessages = 100000;
+  MpscRing ring;
+  ring.Initialize(8);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&ring, p]() {
+      std::string message;
+      for (int i = 0; i < kMessages; i++) {
+        message = std::to_string(i);
+        ring.Add(&message, p);
+      }
+    });
+  }
+
+  std::vector<int> next(kProducers, 0);
+  std::string message;
+  int tag;
+  bool ok = true;
+  for (int i = 0; i < kProducers * kMessages; i++) {
+    ring.Fetch(&message, &tag);
+    if (std::stoi(message) != next[tag]++) {
+      printf("Wrong message from producer %d: %s\n", tag, message.c_str());
+      ok = false;
+    }
+  }
+  for (auto& producer : producers) producer.join();
+  if (ring.TryFetch(&message) != -1) {
+    printf("Ring should be empty\n");
+    ok = false;
+  }
+  ring.Finalize();
+  printf(ok ? "Passed\n" : "Failed\n");
+  return ok ? 0 : 1;
+}
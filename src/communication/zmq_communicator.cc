@@ -1,7 +1,10 @@
 // Copyright 2018 The RPSCC Authors. All Rights Reserved.
 // Author : Chenbin Zhang (zcbin@pku.edu.cn)
 
-#include <cstring>
+#include <deque>
+#include <utility>
+#include <vector>
+
 #include "src/communication/zmq_communicator.h"
 #include "src/util/logging.h"
 
@@ -11,7 +14,6 @@ bool ZmqCommunicator::Initialize(int32 ring_size, bool is_sender,
                             int16 listenport, int32 buffer_size) {
   fifo_ring_.Initialize(ring_size);
   send_recv_.Initialize(is_sender, listenport);
-  buffer_size_ = buffer_size;
 
   if (is_sender) {
     pthread_create(&add_fetch_, NULL, Consume, reinterpret_cast<void*>(this));
@@ -27,18 +29,16 @@ void ZmqCommunicator::Finalize() {
 
 int32 ZmqCommunicator::Send(int32 dst_id, const char* const message,
                             int32 len) {
-  char* mix_message = new char[buffer_size_];
-  snprintf(mix_message, buffer_size_, "%d,", dst_id);
-  int32 offset = strlen(mix_message);
-  memcpy(mix_message + offset, message, len);
-  len += offset;
-  
-  fifo_ring_.Add(mix_message, len);
-  return len;
+  return Send(dst_id, std::string(message, len));
 }
 int32 ZmqCommunicator::Send(int32 dst_id, const std::string& message) {
-  int len = Send(dst_id, message.c_str(), message.size());
-  return len;
+  return Send(dst_id, std::string(message));
+}
+int32 ZmqCommunicator::Send(int32 dst_id, std::string&& message) {
+  // The destination id goes with the message as the tag of its slot.
+  std::string moved;
+  moved.swap(message);
+  return fifo_ring_.Add(&moved, dst_id);
 }
 
 int32 ZmqCommunicator::Receive(char* message, const int32 max_size) {
@@ -46,47 +46,61 @@ int32 ZmqCommunicator::Receive(char* message, const int32 max_size) {
   return len;
 }
 int32 ZmqCommunicator::Receive(std::string* message) {
-  char* char_message = new char[buffer_size_];
-  int len = fifo_ring_.Fetch(char_message, buffer_size_);
-  message->assign(char_message, len);
-  delete char_message;
-  return len;
+  return fifo_ring_.Fetch(message);
 }
 
 // This is a static function.
+// The receiving thread sleeps in zmq_poll until the socket is readable, and
+// then drains every message that has arrived before polling again.
 void* ZmqCommunicator::Produce(void* arg) {
   ZmqCommunicator* zc = reinterpret_cast<ZmqCommunicator*>(arg);
-  static char* message = new char[zc->buffer_size_];
-  static int32 len;
+  std::string message;
 
   while (1) {
-    len = zc->send_recv_.Receive(message, zc->buffer_size_);
-    zc->fifo_ring_.Add(message, len);
-    sleep(1);
+    if (!zc->send_recv_.WaitReadable(-1)) continue;
+    while (zc->send_recv_.TryReceive(&message) >= 0) {
+      zc->fifo_ring_.Add(&message);
+    }
   }
+  return nullptr;
 }
 
 // This is a static function.
+// The sending thread sends a message as soon as it is fetched from the ring.
+// If the destination's zmq queue is full, the message is parked in a
+// per-destination queue and the thread polls the busy sockets, so that one
+// slow node does not stall the messages to the others.
 void* ZmqCommunicator::Consume(void* arg) {
   ZmqCommunicator* zc = reinterpret_cast<ZmqCommunicator*>(arg);
-  static char *mix_message = new char[zc->buffer_size_];
-  static char *message = new char[zc->buffer_size_];
-  static int32 len;
-  static int32 dst_id;
+  std::string message;
+  int32 dst_id;
+  // Messages waiting for their destination to become writable.
+  std::map<std::string, std::deque<std::string>> pending;
+  std::vector<std::string> busy_addrs;
+  std::vector<std::string> writable;
 
   while (1) {
-    // It is necessary for sender to push its dst_id in the message,
-    // because the send_recv_ should know the dst_id to send message.
-    len = zc->fifo_ring_.Fetch(mix_message, zc->buffer_size_);
-    // Extract the dst_id and message from the mix_message
-    // Calculate the true message's length
-    sscanf(mix_message, "%d,", &dst_id);
-    for (int32 i = 0; i < 12; i++)
-      if (mix_message[i] == ',') {
-        len = len - i - 1;
-        memcpy(message, mix_message + i + 1, len);
-        break;
+    int32 len;
+    if (pending.empty()) {
+      len = zc->fifo_ring_.Fetch(&message, &dst_id);
+    } else {
+      len = zc->fifo_ring_.TryFetch(&message, &dst_id);
+    }
+    if (len < 0) {
+      // Nothing new to send, so wait for the busy destinations.
+      busy_addrs.clear();
+      for (auto& item : pending) busy_addrs.push_back(item.first);
+      if (zc->send_recv_.WaitWritable(busy_addrs, 1, &writable) <= 0) continue;
+      for (auto& addr : writable) {
+        std::deque<std::string>& queue = pending[addr];
+        while (!queue.empty() &&
+               zc->send_recv_.TrySend(addr, &queue.front()) >= 0) {
+          queue.pop_front();
+        }
+        if (queue.empty()) pending.erase(addr);
       }
+      continue;
+    }
     // Refer to the id_to_addr_ for dst_addr_
     std::map<int32, std::string>::iterator iter =
                                   zc->id_to_addr_.find(dst_id);
@@ -95,9 +109,16 @@ void* ZmqCommunicator::Consume(void* arg) {
       LOG(ERROR) << "Can not send this message to destination.";
       continue;
     }
-    zc->send_recv_.Send(iter->second, message, len);
-    sleep(1);
+    // Keep the order of messages to the same destination. A message that
+    // can not be sent now keeps its buffer and waits in pending.
+    auto busy = pending.find(iter->second);
+    if (busy != pending.end()) {
+      busy->second.push_back(std::move(message));
+    } else if (zc->send_recv_.TrySend(iter->second, &message) < 0) {
+      pending[iter->second].push_back(std::move(message));
+    }
   }
+  return nullptr;
 }
 
 bool ZmqCommunicator::AddIdAddr(int32 id, std::string addr) {
@@ -8,7 +8,7 @@
 #include <string>
 
 #include "src/communication/communicator.h"
-#include "src/communication/fifo_ring.h"
+#include "src/communication/lock_free_ring.h"
 #include "src/communication/zmq_sendrecv.h"
 #include "src/util/common.h"
 
@@ -20,7 +20,8 @@ class ZmqCommunicator : public Communicator {
   virtual ~ZmqCommunicator() {}
 
   // Initialize the communicator
-  // The buffer_size is used in receiving.
+  // Messages are not limited in size, buffer_size is kept for compatibility
+  // and is not used.
   // Return:
   // true : Init successfully
   // false : Init failed
@@ -35,6 +36,8 @@ class ZmqCommunicator : public Communicator {
   // - 1 : error
   int32 Send(int32 dst_id, const char* const message, int32 len);
   int32 Send(int32 dst_id, const std::string& message);
+  // Move the message to the destination without copying it.
+  int32 Send(int32 dst_id, std::string&& message);
 
   // Receive a message from any node
   // Return:
@@ -56,10 +59,11 @@ class ZmqCommunicator : public Communicator {
   bool CheckIdAddr(int32 id, std::string addr);
 
  private:
-  // Max size of a buffer block
-  int32 buffer_size_;
-  // The fifo ring in the communicator.
-  FifoRing fifo_ring_;
+  // The message ring in the communicator. It is filled by the user threads
+  // and drained by Consume in a sender, and the other way round by Produce
+  // in a receiver. In a sender the tag of every message is its destination
+  // id.
+  MpscRing fifo_ring_;
   // Zmq sender or receiver in the communicator.
   ZmqSendRecv send_recv_;
   // Adder or fetcher thread for the fifo ring.
@@ -0,0 +1,108 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+//
+// Benchmark for ZmqCommunicator.
+// Two pairs of communicators talk to each other through the loopback
+// interface:
+//  ping-pong : node A sends a message to node B, B echoes it back, and the
+//              round-trip latency is recorded for every message.
+//  streaming : node A sends messages to node B as fast as it can, and the
+//              throughput is measured on B.
+//
+// Usage: ./zmq_communicator_benchmark --messages=10000 --message_size=256
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "src/communication/zmq_communicator.h"
+
+DEFINE_int32(messages, 10000, "Number of messages in each test.");
+DEFINE_int32(message_size, 256, "Bytes of each message.");
+DEFINE_int32(port_a, 16001, "Listening port of node A.");
+DEFINE_int32(port_b, 16002, "Listening port of node B.");
+
+using rpscc::ZmqCommunicator;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const int32 kNodeA = 1;
+const int32 kNodeB = 2;
+
+double Percentile(std::vector<double>* samples, double p) {
+  if (samples->empty()) return 0;
+  size_t k = static_cast<size_t>(p * (samples->size() - 1));
+  std::nth_element(samples->begin(), samples->begin() + k, samples->end());
+  return (*samples)[k];
+}
+
+void PingPong(ZmqCommunicator* a_send, ZmqCommunicator* a_recv,
+              const std::string& payload) {
+  std::vector<double> latency_us;
+  latency_us.reserve(FLAGS_messages);
+  std::string reply;
+  Clock::time_point begin = Clock::now();
+  for (int32 i = 0; i < FLAGS_messages; i++) {
+    Clock::time_point t0 = Clock::now();
+    a_send->Send(kNodeB, payload);
+    a_recv->Receive(&reply);
+    latency_us.push_back(std::chrono::duration<double, std::micro>(
+        Clock::now() - t0).count());
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+  printf("ping-pong : %d round trips of %d bytes, %.0f msgs/sec, "
+         "p50 = %.1f us, p99 = %.1f us\n",
+         FLAGS_messages, FLAGS_message_size, FLAGS_messages / seconds,
+         Percentile(&latency_us, 0.5), Percentile(&latency_us, 0.99));
+}
+
+void Streaming(ZmqCommunicator* a_send, ZmqCommunicator* b_recv,
+               const std::string& payload) {
+  std::string message;
+  Clock::time_point begin = Clock::now();
+  std::thread producer([&]() {
+    for (int32 i = 0; i < FLAGS_messages; i++) a_send->Send(kNodeB, payload);
+  });
+  for (int32 i = 0; i < FLAGS_messages; i++) b_recv->Receive(&message);
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+  producer.join();
+  printf("streaming : %d messages of %d bytes, %.0f msgs/sec, %.1f MB/s\n",
+         FLAGS_messages, FLAGS_message_size, FLAGS_messages / seconds,
+         FLAGS_messages * static_cast<double>(FLAGS_message_size) / seconds
+         / (1 << 20));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  ZmqCommunicator a_send, a_recv, b_send, b_recv;
+  a_send.Initialize(1024, true, 0);
+  a_recv.Initialize(1024, false, FLAGS_port_a);
+  b_send.Initialize(1024, true, 0);
+  b_recv.Initialize(1024, false, FLAGS_port_b);
+  a_send.AddIdAddr(kNodeB, "127.0.0.1:" + std::to_string(FLAGS_port_b));
+  b_send.AddIdAddr(kNodeA, "127.0.0.1:" + std::to_string(FLAGS_port_a));
+
+  std::string payload(FLAGS_message_size, 'x');
+
+  // Node B echoes the ping-pong messages back to node A.
+  std::thread echo([&]() {
+    std::string message;
+    for (int32 i = 0; i < FLAGS_messages; i++) {
+      b_recv.Receive(&message);
+      b_send.Send(kNodeA, std::move(message));
+    }
+  });
+  PingPong(&a_send, &a_recv, payload);
+  echo.join();
+
+  Streaming(&a_send, &b_recv, payload);
+  return 0;
+}
@@ -39,8 +39,7 @@ void ZmqSendRecv::Finalize() {
   zmq_ctx_destroy(context_);
 }
 
-int32 ZmqSendRecv::Send(std::string dst_addr, const char* const message,
-                      int len) {
+void* ZmqSendRecv::GetSocket(const std::string& dst_addr) {
   // If there is not a open socket for assigend address, create one socket
   std::map<std::string, void*>::iterator iter = mapper_.find(dst_addr);
   if (iter == mapper_.end()) {
@@ -54,26 +53,138 @@ int32 ZmqSendRecv::Send(std::string dst_addr, const char* const message,
     mapper_.insert(std::make_pair(dst_addr, sender_));
     sendrecv_ = sender_;
   } else {
-    LOG(INFO) << "Use existed socket";
     sendrecv_ = iter->second;
   }
+  return sendrecv_;
+}
+
+int32 ZmqSendRecv::Send(std::string dst_addr, const char* const message,
+                      int len) {
   // Start sending message
-  //printf("message = %s, len = %d\n", message, len);
-  int rc = zmq_send(sendrecv_, message, len, 0);
+  int rc = zmq_send(GetSocket(dst_addr), message, len, 0);
   // LOG(INFO) << "ZmqSend bytes = " << rc << std::endl;
-  //printf("Send_rc = %d\n", rc);
   // I will add a error handler in the future.
   return len;
 }
 
+int32 ZmqSendRecv::TrySend(const std::string& dst_addr,
+                           const char* const message, int len) {
+  int rc = zmq_send(GetSocket(dst_addr), message, len, ZMQ_DONTWAIT);
+  if (rc == -1) {
+    if (zmq_errno() != EAGAIN) {
+      LOG(ERROR) << "Failed to send to " << dst_addr << ": "
+                 << zmq_strerror(zmq_errno());
+    }
+    return -1;
+  }
+  return len;
+}
+
+// zmq calls this when it has sent a message built by Send(std::string*).
+static void FreeString(void* data, void* hint) {
+  delete reinterpret_cast<std::string*>(hint);
+}
+
+int32 ZmqSendRecv::Send(const std::string& dst_addr, std::string* message) {
+  return Send(dst_addr, message, 0);
+}
+
+int32 ZmqSendRecv::TrySend(const std::string& dst_addr, std::string* message) {
+  return Send(dst_addr, message, ZMQ_DONTWAIT);
+}
+
+int32 ZmqSendRecv::Send(const std::string& dst_addr, std::string* message,
+                        int flags) {
+  // The buffer is owned by a heap string until zmq releases it.
+  std::string* buffer = new std::string();
+  buffer->swap(*message);
+  int32 len = buffer->size();
+  zmq_msg_t msg;
+  zmq_msg_init_data(&msg, &(*buffer)[0], len, FreeString, buffer);
+  if (zmq_msg_send(&msg, GetSocket(dst_addr), flags) == -1) {
+    int error = zmq_errno();
+    if (error != EAGAIN) {
+      LOG(ERROR) << "Failed to send to " << dst_addr << ": "
+                 << zmq_strerror(error);
+    }
+    // Give the buffer back before zmq frees the holder.
+    message->swap(*buffer);
+    zmq_msg_close(&msg);
+    return -1;
+  }
+  return len;
+}
+
+int32 ZmqSendRecv::WaitWritable(const std::vector<std::string>& dst_addrs,
+                                int32 timeout,
+                                std::vector<std::string>* writable) {
+  std::vector<zmq_pollitem_t> items(dst_addrs.size());
+  for (size_t i = 0; i < dst_addrs.size(); i++) {
+    items[i].socket = GetSocket(dst_addrs[i]);
+    items[i].fd = 0;
+    items[i].events = ZMQ_POLLOUT;
+    items[i].revents = 0;
+  }
+  writable->clear();
+  int rc = zmq_poll(items.data(), items.size(), timeout);
+  if (rc <= 0) return rc;
+  for (size_t i = 0; i < items.size(); i++) {
+    if (items[i].revents & ZMQ_POLLOUT) writable->push_back(dst_addrs[i]);
+  }
+  return writable->size();
+}
+
 int32 ZmqSendRecv::Receive(char* message, const int32 max_size) {
+  return Receive(message, max_size, 0);
+}
+
+int32 ZmqSendRecv::TryReceive(char* message, const int32 max_size) {
+  return Receive(message, max_size, ZMQ_DONTWAIT);
+}
+
+int32 ZmqSendRecv::Receive(char* message, const int32 max_size, int flags) {
   // Start receiving message
-  int32 msg_size = zmq_recv(sendrecv_, message, max_size, 0);
+  int32 msg_size = zmq_recv(sendrecv_, message, max_size, flags);
+  if (msg_size < 0) return -1;
+  // zmq_recv returns the original size of a truncated message
+  if (msg_size >= max_size) {
+    LOG(ERROR) << "Message of " << msg_size << " bytes is truncated to "
+               << max_size - 1;
+    msg_size = max_size - 1;
+  }
   message[msg_size] = '\0';
-  //printf("Receive message : %s, size = %d\n", message, msg_size);
   return msg_size;
 }
 
+int32 ZmqSendRecv::Receive(std::string* message) {
+  return Receive(message, 0);
+}
+
+int32 ZmqSendRecv::TryReceive(std::string* message) {
+  return Receive(message, ZMQ_DONTWAIT);
+}
+
+int32 ZmqSendRecv::Receive(std::string* message, int flags) {
+  zmq_msg_t msg;
+  zmq_msg_init(&msg);
+  int32 msg_size = zmq_msg_recv(&msg, sendrecv_, flags);
+  if (msg_size >= 0) {
+    message->assign(reinterpret_cast<const char*>(zmq_msg_data(&msg)),
+                    msg_size);
+  }
+  zmq_msg_close(&msg);
+  return msg_size;
+}
+
+bool ZmqSendRecv::WaitReadable(int32 timeout) {
+  zmq_pollitem_t item;
+  item.socket = sendrecv_;
+  item.fd = 0;
+  item.events = ZMQ_POLLIN;
+  item.revents = 0;
+  return zmq_poll(&item, 1, timeout) > 0 && (item.revents & ZMQ_POLLIN);
+}
+
 int32 ZmqSendRecv::CloseSocket(std::string dst_addr) {
   int32 res = 0;
   std::map<std::string, void*>::iterator iter = mapper_.find(dst_addr);
@@ -8,7 +8,7 @@
 #include <cstring>
 #include <string>
 #include <map>
-
+#include <vector>
 
 #include "src/util/common.h"
 
@@ -39,15 +39,57 @@ class ZmqSendRecv {
   // Return : bytes send to remote
   int32 Send(std::string dst_addr, const char* const message, int len);
 
+  // Send data without blocking.
+  // Return : bytes send to remote, or -1 if the remote's queue is full and
+  // the message should be tried again later
+  int32 TrySend(const std::string& dst_addr, const char* const message,
+                int len);
+
+  // Send the content of message without copying it. The buffer of message
+  // is handed over to zmq and message is left empty, unless the remote's
+  // queue is full (TrySend returns -1), then message is kept unchanged.
+  // Return : bytes send to remote, or -1 on failure
+  int32 Send(const std::string& dst_addr, std::string* message);
+  int32 TrySend(const std::string& dst_addr, std::string* message);
+
+  // Wait until at least one of dst_addrs can accept a message or the timeout
+  // (in milliseconds, -1 means forever) expires. The writable addresses are
+  // stored in writable.
+  // Return : number of writable addresses, or -1 on error
+  int32 WaitWritable(const std::vector<std::string>& dst_addrs,
+                     int32 timeout, std::vector<std::string>* writable);
+
   // Receive data using zmq
   // Return : bytes received
   int32 Receive(char* message, const int max_size);
 
+  // Receive data without blocking.
+  // Return : bytes received, or -1 if there is no pending message
+  int32 TryReceive(char* message, const int max_size);
+
+  // Receive a message of any size into message.
+  // Return : bytes received, or -1 if there is no pending message (for
+  // TryReceive) or an error occurs
+  int32 Receive(std::string* message);
+  int32 TryReceive(std::string* message);
+
+  // Wait until the receiving socket has a message or the timeout (in
+  // milliseconds, -1 means forever) expires.
+  // Return : true if a message can be received
+  bool WaitReadable(int32 timeout);
+
   // Close conncetion
   // Return: 0 if it is closed successfully, -1 else
   int32 CloseSocket(std::string dst_addr);
 
  private:
+  // Fetch the socket connected to dst_addr, or create one.
+  void* GetSocket(const std::string& dst_addr);
+  // Receive with the given zmq flags, and terminate the message with '\0'.
+  int32 Receive(char* message, const int max_size, int flags);
+  int32 Send(const std::string& dst_addr, std::string* message, int flags);
+  int32 Receive(std::string* message, int flags);
+
   bool is_sender_;
   int16 listen_port_;
   // Context for zmq
@@ -20,6 +20,21 @@ DEFINE_int32(server_num, 1, "The number of server.");
 DEFINE_int32(key_range, 0, "The total number of features.");
 DEFINE_int32(bound, 0, "The definition of consistency.");
 DEFINE_int32(backup_size, 0, "The number of backup server.");
+DEFINE_string(optimizer, "add", "The optimizer of the servers: add, sgd, "
+              "momentum, adagrad, adam or ftrl.");
+DEFINE_double(learning_rate, 0, "Learning rate of the optimizer, alpha of "
+              "ftrl. 0 takes the optimizer's default.");
+DEFINE_double(momentum, 0, "Momentum of the momentum optimizer.");
+DEFINE_double(beta1, 0, "beta1 of adam.");
+DEFINE_double(beta2, 0, "beta2 of adam.");
+DEFINE_double(epsilon, 0, "epsilon of adagrad and adam.");
+DEFINE_double(ftrl_beta, 0, "beta of ftrl.");
+DEFINE_double(l1, 0, "L1 regularization of ftrl.");
+DEFINE_double(l2, 0, "L2 regularization of ftrl.");
+DEFINE_int32(sparse_capacity, 0, "The number of distinct keys a server of a "
+             "sparse task can hold, 0 for a dense task.");
+DEFINE_string(snapshot_dir, "", "Directory of the checkpoints the servers "
+              "start from, see --checkpoint_dir of the server.");
 
 std::default_random_engine TaskConfig::generator_;
 std::unique_ptr<std::uniform_int_distribution<int>> TaskConfig::distribution_;
@@ -33,6 +48,17 @@ void rpscc::TaskConfig::Initialize(const std::string &config_file) {
   // [1, key_range - 2], because we should not generate
   // index 0 and index key_range - 2
   backup_size_ = FLAGS_backup_size;
+  optimizer_.set_name(FLAGS_optimizer);
+  optimizer_.set_learning_rate(FLAGS_learning_rate);
+  optimizer_.set_momentum(FLAGS_momentum);
+  optimizer_.set_beta1(FLAGS_beta1);
+  optimizer_.set_beta2(FLAGS_beta2);
+  optimizer_.set_epsilon(FLAGS_epsilon);
+  optimizer_.set_beta(FLAGS_ftrl_beta);
+  optimizer_.set_l1(FLAGS_l1);
+  optimizer_.set_l2(FLAGS_l2);
+  sparse_capacity_ = FLAGS_sparse_capacity;
+  snapshot_dir_ = FLAGS_snapshot_dir;
   distribution_.reset(
     new std::uniform_int_distribution<int>(1, key_range_ - 2));
 }
@@ -47,6 +73,9 @@ Message_ConfigMessage *TaskConfig::ToMessage() {
   config_msg->set_bound(bound_);
   config_msg->set_key_range(key_range_);
   config_msg->set_backup_size(backup_size_);
+  *config_msg->mutable_optimizer() = optimizer_;
+  config_msg->set_sparse_capacity(sparse_capacity_);
+  config_msg->set_snapshot_dir(snapshot_dir_);
   // assert(server_ip_.size() == server_port_.size());
   std::vector<std::pair<int32_t, std::string>> temp(id_to_addr_.begin(),
     id_to_addr_.end());
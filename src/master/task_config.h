@@ -119,6 +119,9 @@ class TaskConfig {
   std::unordered_map<int32_t, std::string> id_to_addr_;
   std::unordered_map<std::string, int32_t> addr_to_id_;
   int32 bound_;
+  Message_OptimizerConfig optimizer_;
+  int32 sparse_capacity_;
+  std::string snapshot_dir_;
   int32_t node_id_ = 0;
   std::mutex mu_;
   bool config_changed_ = false;
@@ -0,0 +1,152 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/message/key_value_codec.h"
+
+#include <cstring>
+
+namespace rpscc {
+
+namespace {
+
+struct PayloadHeader {
+  uint32 flags;
+  int32 size;
+};
+
+// Round len up to a multiple of 4 bytes, so that the values which follow
+// the keys are aligned.
+inline size_t Align4(size_t len) { return (len + 3) & ~static_cast<size_t>(3); }
+
+inline uint32 ZigZag(int32 value) {
+  return (static_cast<uint32>(value) << 1) ^ static_cast<uint32>(value >> 31);
+}
+
+inline int32 UnZigZag(uint32 value) {
+  return static_cast<int32>(value >> 1) ^ -static_cast<int32>(value & 1);
+}
+
+}  // namespace
+
+void KeyValueCodec::Encode(const int32* keys, const float32* values,
+                           int32 size, bool delta_keys,
+                           std::string* payload) {
+  PayloadHeader header;
+  header.flags = (values != NULL ? kHasValues : 0) |
+                 (delta_keys ? kDeltaKeys : 0);
+  header.size = size;
+  size_t values_bytes = values != NULL ? size * sizeof(float32) : 0;
+  // A varint of 32 bits takes at most 5 bytes.
+  size_t keys_bytes = delta_keys ? Align4(size * 5) : size * sizeof(int32);
+  payload->resize(sizeof(header) + keys_bytes + values_bytes);
+  char* out = &(*payload)[0];
+  memcpy(out, &header, sizeof(header));
+  out += sizeof(header);
+
+  if (delta_keys) {
+    uint8* begin = reinterpret_cast<uint8*>(out);
+    uint8* p = begin;
+    int32 previous = 0;
+    for (int32 i = 0; i < size; i++) {
+      uint32 delta = ZigZag(static_cast<int32>(
+          static_cast<uint32>(keys[i]) - static_cast<uint32>(previous)));
+      previous = keys[i];
+      while (delta >= 0x80) {
+        *p++ = static_cast<uint8>(delta | 0x80);
+        delta >>= 7;
+      }
+      *p++ = static_cast<uint8>(delta);
+    }
+    keys_bytes = Align4(p - begin);
+    memset(p, 0, begin + keys_bytes - p);
+  } else {
+    memcpy(out, keys, keys_bytes);
+  }
+  out += keys_bytes;
+  if (values != NULL) memcpy(out, values, values_bytes);
+  payload->resize(sizeof(header) + keys_bytes + values_bytes);
+}
+
+void SetKeyValues(const int32* keys, const float32* values, int32 size,
+                  bool binary, bool delta_keys,
+                  Message_RequestMessage* request) {
+  if (binary) {
+    request->clear_keys();
+    request->clear_values();
+    KeyValueCodec::Encode(keys, values, size, delta_keys,
+                          request->mutable_payload());
+    return;
+  }
+  request->clear_payload();
+  request->mutable_keys()->Resize(size, 0);
+  memcpy(request->mutable_keys()->mutable_data(), keys,
+         size * sizeof(int32));
+  if (values != NULL) {
+    request->mutable_values()->Resize(size, 0.0f);
+    memcpy(request->mutable_values()->mutable_data(), values,
+           size * sizeof(float32));
+  } else {
+    request->clear_values();
+  }
+}
+
+bool KeyValueReader::Parse(const Message_RequestMessage& request) {
+  binary_ = !request.payload().empty();
+  if (!binary_) {
+    size_ = request.keys_size();
+    keys_ = request.keys().data();
+    values_ = request.values_size() == size_ && size_ > 0 ?
+              request.values().data() : NULL;
+    return request.values_size() == 0 || request.values_size() == size_;
+  }
+
+  const std::string& payload = request.payload();
+  const char* in = payload.data();
+  const char* end = in + payload.size();
+  PayloadHeader header;
+  if (payload.size() < sizeof(header)) return false;
+  memcpy(&header, in, sizeof(header));
+  in += sizeof(header);
+  // Every key takes at least a byte, so a size beyond the payload is
+  // rejected before the keys are decoded into a buffer of that size.
+  if (header.size < 0 || header.size > end - in) return false;
+  size_ = header.size;
+
+  if (header.flags & KeyValueCodec::kDeltaKeys) {
+    const uint8* begin = reinterpret_cast<const uint8*>(in);
+    const uint8* p = begin;
+    const uint8* limit = reinterpret_cast<const uint8*>(end);
+    decoded_keys_.resize(size_);
+    int32 previous = 0;
+    for (int32 i = 0; i < size_; i++) {
+      uint32 delta = 0;
+      int32 shift = 0;
+      do {
+        if (p == limit || shift > 28) return false;
+        delta |= static_cast<uint32>(*p & 0x7f) << shift;
+        shift += 7;
+      } while (*p++ & 0x80);
+      previous = static_cast<int32>(static_cast<uint32>(previous) +
+                                    static_cast<uint32>(UnZigZag(delta)));
+      decoded_keys_[i] = previous;
+    }
+    in += Align4(p - begin);
+    keys_ = decoded_keys_.data();
+  } else {
+    if (static_cast<size_t>(end - in) < size_ * sizeof(int32)) return false;
+    keys_ = reinterpret_cast<const int32*>(in);
+    in += size_ * sizeof(int32);
+  }
+
+  if (header.flags & KeyValueCodec::kHasValues) {
+    if (in > end ||
+        static_cast<size_t>(end - in) < size_ * sizeof(float32)) {
+      return false;
+    }
+    values_ = reinterpret_cast<const float32*>(in);
+  } else {
+    values_ = NULL;
+  }
+  return true;
+}
+
+}  // namespace rpscc
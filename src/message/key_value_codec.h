@@ -0,0 +1,78 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+//
+// Binary payload of push and pull requests.
+
+#ifndef SRC_MESSAGE_KEY_VALUE_CODEC_H_
+#define SRC_MESSAGE_KEY_VALUE_CODEC_H_
+
+#include <string>
+#include <vector>
+
+#include "src/message/message.pb.h"
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// The keys and values of a RequestMessage can be carried either in the
+// repeated fields or in the binary payload field. Filling the repeated
+// fields costs a call and a varint per element, while the payload is
+// written and read with memcpy:
+//
+//   uint32  flags         kHasValues | kDeltaKeys
+//   int32   size          number of keys
+//   keys                  size int32, or zigzag varint deltas between
+//                         consecutive keys padded to 4 bytes (kDeltaKeys)
+//   values                size float32 (kHasValues)
+//
+// Every number is little-endian, which is the byte order of the hosts rpscc
+// runs on, so no conversion is done.
+class KeyValueCodec {
+ public:
+  enum Flags {
+    kHasValues = 1,
+    kDeltaKeys = 2,
+  };
+
+  // Encode size keys and values into payload. values may be NULL for pull
+  // requests. Delta encoding is meant for sorted keys, for which most
+  // deltas fit in one or two bytes, but any keys can be encoded.
+  static void Encode(const int32* keys, const float32* values, int32 size,
+                     bool delta_keys, std::string* payload);
+};
+
+// Fill the keys and values of request, either as a binary payload or in the
+// repeated fields. values may be NULL.
+void SetKeyValues(const int32* keys, const float32* values, int32 size,
+                  bool binary, bool delta_keys,
+                  Message_RequestMessage* request);
+
+// KeyValueReader gives the keys and values of a RequestMessage as arrays,
+// whichever way they are carried. The arrays point into the request, so the
+// request must outlive the reader, except for delta encoded keys, which are
+// decoded into the reader.
+class KeyValueReader {
+ public:
+  KeyValueReader() : keys_(NULL), values_(NULL), size_(0), binary_(false) {}
+
+  // Return false if the payload is malformed.
+  bool Parse(const Message_RequestMessage& request);
+
+  int32 size() const { return size_; }
+  const int32* keys() const { return keys_; }
+  // NULL if the request carries no values.
+  const float32* values() const { return values_; }
+  // Whether the request uses the binary payload, replies should use the
+  // same format as requests.
+  bool binary() const { return binary_; }
+
+ private:
+  const int32* keys_;
+  const float32* values_;
+  int32 size_;
+  bool binary_;
+  std::vector<int32> decoded_keys_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_MESSAGE_KEY_VALUE_CODEC_H_
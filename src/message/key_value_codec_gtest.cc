@@ -0,0 +1,90 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/message/key_value_codec.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace rpscc;
+
+namespace {
+
+void ExpectRoundTrip(const std::vector<int32>& keys,
+                     const std::vector<float32>& values,
+                     bool binary, bool delta_keys) {
+  Message_RequestMessage request;
+  SetKeyValues(keys.data(), values.empty() ? NULL : values.data(),
+               keys.size(), binary, delta_keys, &request);
+  // Go through the wire as the agent and server do.
+  Message_RequestMessage parsed;
+  ASSERT_TRUE(parsed.ParseFromString(request.SerializeAsString()));
+
+  KeyValueReader reader;
+  ASSERT_TRUE(reader.Parse(parsed));
+  EXPECT_EQ(binary, reader.binary());
+  ASSERT_EQ(static_cast<int32>(keys.size()), reader.size());
+  for (size_t i = 0; i < keys.size(); i++) EXPECT_EQ(keys[i], reader.keys()[i]);
+  if (values.empty()) {
+    EXPECT_TRUE(reader.values() == NULL);
+  } else {
+    ASSERT_TRUE(reader.values() != NULL);
+    for (size_t i = 0; i < values.size(); i++)
+      EXPECT_EQ(values[i], reader.values()[i]);
+  }
+}
+
+}  // namespace
+
+TEST(KeyValueCodecTest, RoundTrip) {
+  std::vector<int32> keys = {0, 1, 2, 130, 131, 70000, 2147483647};
+  std::vector<float32> values = {0.5f, -1.0f, 3.25f, 0.0f, 1e-8f, 7.0f, -2.5f};
+  for (bool binary : {false, true}) {
+    for (bool delta_keys : {false, true}) {
+      ExpectRoundTrip(keys, values, binary, delta_keys);
+      ExpectRoundTrip(keys, std::vector<float32>(), binary, delta_keys);
+    }
+  }
+}
+
+TEST(KeyValueCodecTest, UnsortedAndNegativeKeys) {
+  // The shard of the last server wraps around the key range.
+  std::vector<int32> keys = {90, 95, 99, 0, 3, -2147483647 - 1, 5};
+  std::vector<float32> values(keys.size(), 1.0f);
+  ExpectRoundTrip(keys, values, true, true);
+}
+
+TEST(KeyValueCodecTest, Empty) {
+  ExpectRoundTrip(std::vector<int32>(), std::vector<float32>(), true, true);
+  ExpectRoundTrip(std::vector<int32>(), std::vector<float32>(), false, false);
+}
+
+TEST(KeyValueCodecTest, DeltaKeysAreCompact) {
+  std::vector<int32> keys;
+  for (int32 i = 0; i < 1000; i++) keys.push_back(1000000 + i * 3);
+  std::string raw, delta;
+  KeyValueCodec::Encode(keys.data(), NULL, keys.size(), false, &raw);
+  KeyValueCodec::Encode(keys.data(), NULL, keys.size(), true, &delta);
+  EXPECT_LT(delta.size() * 3, raw.size());
+}
+
+TEST(KeyValueCodecTest, Malformed) {
+  std::vector<int32> keys = {1, 2, 3};
+  std::vector<float32> values = {1.0f, 2.0f, 3.0f};
+  Message_RequestMessage request;
+  SetKeyValues(keys.data(), values.data(), keys.size(), true, false,
+               &request);
+  request.mutable_payload()->resize(request.payload().size() - 1);
+  KeyValueReader reader;
+  EXPECT_FALSE(reader.Parse(request));
+  request.set_payload("abc");
+  EXPECT_FALSE(reader.Parse(request));
+  // A header claiming more keys than the payload has bytes.
+  for (int32 flags : {0, static_cast<int32>(KeyValueCodec::kDeltaKeys)}) {
+    int32 header[2] = {flags, 0x7fffffff};
+    request.set_payload(std::string(reinterpret_cast<const char*>(header),
+                                    sizeof(header)));
+    EXPECT_FALSE(reader.Parse(request)) << flags;
+  }
+}
@@ -0,0 +1,121 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/checkpoint.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rpscc {
+
+const uint64 CheckpointHeader::kMagic;
+const int32 CheckpointHeader::kFormat;
+
+namespace {
+
+const int64 kAlignment = 64;
+
+int64 Align(int64 offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Write size bytes of data at offset, after zeros from the current end.
+bool WriteAt(FILE* file, int64 offset, const void* data, int64 size) {
+  static const char kZeros[kAlignment] = {0};
+  int64 position = ftell(file);
+  if (position > offset ||
+      fwrite(kZeros, 1, offset - position, file) != offset - position)
+    return false;
+  return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+}  // namespace
+
+bool Checkpoint::Write(const std::string& path) const {
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = CheckpointHeader::kMagic;
+  header.format = CheckpointHeader::kFormat;
+  header.version = version;
+  header.start_key = start_key;
+  header.key_range = key_range;
+  header.length = values.size();
+  header.keys = keys.size();
+  header.state_arrays = state.size();
+  header.steps = steps;
+  if (optimizer.size() >= sizeof(header.optimizer)) return false;
+  memcpy(header.optimizer, optimizer.data(), optimizer.size());
+  int64 array_bytes = header.length * sizeof(float32);
+  header.values_offset = Align(sizeof(header));
+  header.state_offset = Align(header.values_offset + array_bytes);
+  header.keys_offset = Align(header.state_offset +
+                             header.state_arrays * array_bytes);
+  header.file_size = header.keys_offset + header.keys * sizeof(int64);
+
+  std::string tmp_path = path + ".tmp";
+  FILE* file = fopen(tmp_path.c_str(), "wb");
+  if (file == NULL) return false;
+  bool ok = WriteAt(file, 0, &header, sizeof(header)) &&
+            WriteAt(file, header.values_offset, values.data(), array_bytes);
+  for (int32 i = 0; ok && i < header.state_arrays; ++i) {
+    ok = state[i].size() == values.size() &&
+         WriteAt(file, header.state_offset + i * array_bytes,
+                 state[i].data(), array_bytes);
+  }
+  ok = ok && WriteAt(file, header.keys_offset, keys.data(),
+                     header.keys * sizeof(int64)) &&
+       fflush(file) == 0 && fsync(fileno(file)) == 0;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool MappedCheckpoint::Open(const std::string& path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= sizeof(CheckpointHeader)) {
+    data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  data_ = data;
+  size_ = st.st_size;
+
+  // The arrays must lie in the file, in the order of the format.
+  const CheckpointHeader& h = header();
+  int64 array_bytes = h.length * sizeof(float32);
+  if (h.magic != CheckpointHeader::kMagic ||
+      h.format != CheckpointHeader::kFormat || h.file_size != size_ ||
+      h.length < 0 || h.keys < 0 || h.keys > h.length ||
+      h.state_arrays < 0 || h.steps < 0 ||
+      h.optimizer[sizeof(h.optimizer) - 1] != '\0' ||
+      h.values_offset % kAlignment != 0 ||
+      h.state_offset % kAlignment != 0 ||
+      h.values_offset < sizeof(CheckpointHeader) ||
+      h.state_offset < h.values_offset + array_bytes ||
+      h.keys_offset < h.state_offset + h.state_arrays * array_bytes ||
+      h.keys_offset % kAlignment != 0 ||
+      h.file_size != h.keys_offset + h.keys * sizeof(int64)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedCheckpoint::Close() {
+  if (data_ != NULL) munmap(data_, size_);
+  data_ = NULL;
+  size_ = 0;
+}
+
+}  // namespace rpscc
@@ -0,0 +1,103 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#ifndef SRC_SERVER_CHECKPOINT_H_
+#define SRC_SERVER_CHECKPOINT_H_
+
+#include <string>
+#include <vector>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// The file of a checkpoint is flat, so a restarted server can map it and
+// use the arrays in place instead of reading and parsing them. It is a
+// CheckpointHeader followed by the arrays, each at the offset given in the
+// header, which is a multiple of 64:
+//
+//   float32 values[length]                  the parameters
+//   float32 state[state_arrays][length]     the arrays of the optimizer
+//   int64 keys[keys]                        the key of each slot of a
+//                                           sparse server
+//
+// Numbers are in the byte order of the host which wrote the file.
+struct CheckpointHeader {
+  static const uint64 kMagic = 0x54504b4343535052ULL;  // "RPSCCKPT"
+  static const int32 kFormat = 2;
+
+  uint64 magic;
+  int32 format;
+  // Number of updates applied to the parameters.
+  int32 version;
+  int32 start_key;
+  int32 key_range;
+  int64 length;
+  int64 keys;
+  int32 state_arrays;
+  // Number of steps of the optimizer since its state was reset.
+  int32 steps;
+  // Name of the optimizer, NUL terminated.
+  char optimizer[16];
+  int64 values_offset;
+  int64 state_offset;
+  int64 keys_offset;
+  int64 file_size;
+};
+
+// Checkpoint is a snapshot of the parameters of a server, copied between
+// two updates so it is consistent, and written to a file while the server
+// goes on.
+struct Checkpoint {
+  int32 version;
+  int32 start_key;
+  int32 key_range;
+  std::string optimizer;
+  std::vector<float32> values;
+  // The arrays of the optimizer, each as long as values.
+  std::vector<std::vector<float32>> state;
+  // Number of steps of the optimizer, which the server counts for all its
+  // shards.
+  int32 steps;
+  // The keys of the slots of a sparse server, empty for a dense one.
+  std::vector<int64> keys;
+
+  // Write the checkpoint to path. It is written to path.tmp first and then
+  // renamed, so a crash while writing leaves the last checkpoint intact.
+  bool Write(const std::string& path) const;
+};
+
+// MappedCheckpoint maps a checkpoint file. The mapping is private, so the
+// arrays can be written in place without changing the file: the pages
+// written are copied on write.
+class MappedCheckpoint {
+ public:
+  MappedCheckpoint() : data_(NULL), size_(0) {}
+  ~MappedCheckpoint() { Close(); }
+
+  // Map the checkpoint at path. Return false if it cannot be read or is not
+  // a checkpoint of this format.
+  bool Open(const std::string& path);
+  void Close();
+
+  const CheckpointHeader& header() const {
+    return *reinterpret_cast<const CheckpointHeader*>(data_);
+  }
+  float32* values() { return Array<float32>(header().values_offset); }
+  float32* state(int32 i) {
+    return Array<float32>(header().state_offset) + i * header().length;
+  }
+  const int64* keys() { return Array<int64>(header().keys_offset); }
+
+ private:
+  template <typename T>
+  T* Array(int64 offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(data_) + offset);
+  }
+
+  void* data_;
+  size_t size_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_CHECKPOINT_H_
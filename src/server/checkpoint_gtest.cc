@@ -0,0 +1,78 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/server/checkpoint.h"
+
+using namespace rpscc;
+
+namespace {
+
+Checkpoint Example() {
+  Checkpoint checkpoint;
+  checkpoint.version = 12;
+  checkpoint.start_key = 100;
+  checkpoint.key_range = 1000;
+  checkpoint.optimizer = "adam";
+  checkpoint.values = {0.5f, -1.0f, 2.0f};
+  checkpoint.state = {{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}};
+  checkpoint.steps = 9;
+  checkpoint.keys = {7, 1ll << 40};
+  return checkpoint;
+}
+
+}  // namespace
+
+TEST(Checkpoint, WriteAndMap) {
+  std::string path = testing::TempDir() + "checkpoint_gtest.ckpt";
+  Checkpoint checkpoint = Example();
+  ASSERT_TRUE(checkpoint.Write(path));
+
+  MappedCheckpoint mapped;
+  ASSERT_TRUE(mapped.Open(path));
+  const CheckpointHeader& header = mapped.header();
+  EXPECT_EQ(12, header.version);
+  EXPECT_EQ(100, header.start_key);
+  EXPECT_EQ(1000, header.key_range);
+  EXPECT_EQ(3, header.length);
+  EXPECT_STREQ("adam", header.optimizer);
+  EXPECT_EQ(checkpoint.values,
+            std::vector<float32>(mapped.values(), mapped.values() + 3));
+  EXPECT_EQ(checkpoint.state[1],
+            std::vector<float32>(mapped.state(1), mapped.state(1) + 3));
+  EXPECT_EQ(9, header.steps);
+  ASSERT_EQ(2, header.keys);
+  EXPECT_EQ(1ll << 40, mapped.keys()[1]);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(mapped.values()) % 64);
+
+  // Writing the mapped values leaves the file unchanged.
+  mapped.values()[0] = 3.0f;
+  MappedCheckpoint again;
+  ASSERT_TRUE(again.Open(path));
+  EXPECT_EQ(0.5f, again.values()[0]);
+  remove(path.c_str());
+}
+
+TEST(Checkpoint, Malformed) {
+  std::string path = testing::TempDir() + "checkpoint_gtest.ckpt";
+  MappedCheckpoint mapped;
+  remove(path.c_str());
+  EXPECT_FALSE(mapped.Open(path));
+
+  ASSERT_TRUE(Example().Write(path));
+  // A truncated file.
+  ASSERT_EQ(0, truncate(path.c_str(), 100));
+  EXPECT_FALSE(mapped.Open(path));
+
+  FILE* file = fopen(path.c_str(), "wb");
+  fputs("not a checkpoint, but long enough to hold the header of one, "
+        "which is checked before anything else", file);
+  fclose(file);
+  EXPECT_FALSE(mapped.Open(path));
+  remove(path.c_str());
+}
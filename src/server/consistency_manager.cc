@@ -0,0 +1,65 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/consistency_manager.h"
+
+#include <algorithm>
+
+namespace rpscc {
+
+const int32 ConsistencyManager::kWait;
+
+void ConsistencyManager::Reset(int32 bound, int32 version) {
+  bound_ = std::max(bound, 0);
+  version_ = version;
+  unapplied_ = 0;
+  clocks_.clear();
+}
+
+void ConsistencyManager::AddAgent(int32 id) {
+  if (!HasAgent(id)) clocks_[id] = version_;
+}
+
+void ConsistencyManager::RemoveAgent(int32 id) {
+  clocks_.erase(id);
+}
+
+int32 ConsistencyManager::MinClock() const {
+  if (clocks_.empty()) return version_;
+  int32 min_clock = clocks_.begin()->second;
+  for (auto& clock : clocks_) min_clock = std::min(min_clock, clock.second);
+  return min_clock;
+}
+
+int32 ConsistencyManager::PushOffset(int32 id) const {
+  if (async()) return 0;
+  int32 offset = Clock(id) - version_;
+  return offset < bound_ ? offset : kWait;
+}
+
+void ConsistencyManager::Commit(int32 id) {
+  clocks_[id]++;
+  if (async()) unapplied_++;
+}
+
+bool ConsistencyManager::Complete() const {
+  if (async()) return unapplied_ > 0;
+  return !clocks_.empty() && MinClock() > version_;
+}
+
+void ConsistencyManager::Advance() {
+  version_++;
+  unapplied_ = 0;
+}
+
+int32 ConsistencyManager::Restart(int32 version) {
+  int32 dropped = async() && unapplied_ > 0 ? 1 : 0;
+  for (auto& clock : clocks_) {
+    if (!async()) dropped = std::max(dropped, clock.second - version_);
+    clock.second = version;
+  }
+  version_ = version;
+  unapplied_ = 0;
+  return dropped;
+}
+
+}  // namespace rpscc
@@ -0,0 +1,84 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#ifndef SRC_SERVER_CONSISTENCY_MANAGER_H_
+#define SRC_SERVER_CONSISTENCY_MANAGER_H_
+
+#include <map>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// ConsistencyManager keeps the clock of every agent, the number of versions
+// it has pushed, and the version of the server, the number of versions
+// applied, and decides from them when a push is summed up, when a version
+// is applied, and when a pull waits. The bound of the task picks the model:
+//
+//   BSP  bound 1. Version v is applied once every agent has pushed it, and
+//        an agent pulls only after its pushes are applied.
+//   SSP  bound s > 1. The same, but an agent may be s versions ahead of the
+//        server, so it pulls parameters up to s - 1 versions stale.
+//   ASP  bound <= 0, i.e. infinite. Every push is a version of its own and
+//        is applied on arrival, nothing waits.
+//
+// The clock of an agent is at most bound versions ahead of the server: a
+// push beyond it waits for the versions before it to be applied, and the
+// slowest agent, whose clock is the min clock, decides when that is.
+class ConsistencyManager {
+ public:
+  // The offset of a push which must wait.
+  static const int32 kWait = -1;
+
+  ConsistencyManager() : bound_(1), version_(0), unapplied_(0) {}
+
+  // Start over with no agents at version.
+  void Reset(int32 bound, int32 version);
+
+  bool async() const { return bound_ <= 0; }
+  // Number of versions summed up at once: bound, or 1 under ASP.
+  int32 versions() const { return async() ? 1 : bound_; }
+  int32 version() const { return version_; }
+
+  // A new agent starts at the version of the server.
+  void AddAgent(int32 id);
+  // The versions no longer wait for a removed agent. Its pushes which are
+  // summed up stay in the sums.
+  void RemoveAgent(int32 id);
+  bool HasAgent(int32 id) const { return clocks_.count(id) > 0; }
+  int32 agents() const { return clocks_.size(); }
+
+  int32 Clock(int32 id) const { return clocks_.at(id); }
+  // The clock of the slowest agent, or the version if there are none.
+  int32 MinClock() const;
+
+  // The version above version() the next push of agent belongs to, or
+  // kWait if the agent is bound versions ahead.
+  int32 PushOffset(int32 id) const;
+  // Count a push of agent, at the offset PushOffset() gave.
+  void Commit(int32 id);
+  // Whether the version after version() is pushed by every agent, or under
+  // ASP, whether a push is not yet applied.
+  bool Complete() const;
+  // Count the version after version() as applied.
+  void Advance();
+  // Drop the versions pushed but not applied, and go on from version.
+  // Return the number of versions dropped.
+  int32 Restart(int32 version);
+
+  // Whether a pull of agent waits for the version WaitVersion().
+  bool PullWaits(int32 id) const {
+    return !async() && Clock(id) - version_ >= bound_;
+  }
+  int32 WaitVersion(int32 id) const { return Clock(id) - bound_ + 1; }
+
+ private:
+  int32 bound_;
+  int32 version_;
+  // Under ASP, the number of pushes not yet applied.
+  int32 unapplied_;
+  std::map<int32, int32> clocks_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_CONSISTENCY_MANAGER_H_
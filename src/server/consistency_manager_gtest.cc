@@ -0,0 +1,82 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "gtest/gtest.h"
+#include "src/server/consistency_manager.h"
+
+using namespace rpscc;
+
+TEST(ConsistencyManager, Bsp) {
+  ConsistencyManager consistency;
+  consistency.Reset(1, 0);
+  consistency.AddAgent(1);
+  consistency.AddAgent(2);
+  EXPECT_FALSE(consistency.async());
+  EXPECT_EQ(1, consistency.versions());
+
+  EXPECT_EQ(0, consistency.PushOffset(1));
+  consistency.Commit(1);
+  EXPECT_TRUE(consistency.PullWaits(1));
+  EXPECT_EQ(1, consistency.WaitVersion(1));
+  EXPECT_FALSE(consistency.PullWaits(2));
+  // A second push waits for the first version.
+  EXPECT_EQ(ConsistencyManager::kWait, consistency.PushOffset(1));
+  EXPECT_FALSE(consistency.Complete());
+
+  consistency.Commit(2);
+  EXPECT_EQ(1, consistency.MinClock());
+  ASSERT_TRUE(consistency.Complete());
+  consistency.Advance();
+  EXPECT_EQ(1, consistency.version());
+  EXPECT_FALSE(consistency.Complete());
+  EXPECT_FALSE(consistency.PullWaits(1));
+  EXPECT_EQ(0, consistency.PushOffset(1));
+}
+
+TEST(ConsistencyManager, Ssp) {
+  ConsistencyManager consistency;
+  consistency.Reset(3, 10);
+  consistency.AddAgent(1);
+  consistency.AddAgent(2);
+  for (int32 offset = 0; offset < 3; ++offset) {
+    EXPECT_FALSE(consistency.PullWaits(1));
+    EXPECT_EQ(offset, consistency.PushOffset(1));
+    consistency.Commit(1);
+  }
+  EXPECT_EQ(ConsistencyManager::kWait, consistency.PushOffset(1));
+  EXPECT_TRUE(consistency.PullWaits(1));
+  EXPECT_EQ(11, consistency.WaitVersion(1));
+  EXPECT_EQ(10, consistency.MinClock());
+  EXPECT_FALSE(consistency.Complete());
+
+  // The slowest agent leaves, and the versions no longer wait for it.
+  consistency.RemoveAgent(2);
+  EXPECT_EQ(13, consistency.MinClock());
+  EXPECT_TRUE(consistency.Complete());
+  consistency.Advance();
+  EXPECT_EQ(2, consistency.PushOffset(1));
+
+  // A new agent starts at the version of the server.
+  consistency.AddAgent(3);
+  EXPECT_EQ(11, consistency.Clock(3));
+  EXPECT_EQ(2, consistency.Restart(11));
+  EXPECT_EQ(11, consistency.Clock(1));
+}
+
+TEST(ConsistencyManager, Asp) {
+  ConsistencyManager consistency;
+  consistency.Reset(0, 0);
+  consistency.AddAgent(1);
+  consistency.AddAgent(2);
+  EXPECT_TRUE(consistency.async());
+  EXPECT_EQ(1, consistency.versions());
+  EXPECT_FALSE(consistency.Complete());
+  for (int32 i = 0; i < 5; ++i) {
+    EXPECT_EQ(0, consistency.PushOffset(1));
+    EXPECT_FALSE(consistency.PullWaits(1));
+    consistency.Commit(1);
+    ASSERT_TRUE(consistency.Complete());
+    consistency.Advance();
+  }
+  EXPECT_EQ(5, consistency.version());
+  EXPECT_FALSE(consistency.Complete());
+}
@@ -12,6 +12,13 @@ void KeyValueList::AddPair(int32 key, float value) {
   length_++;
 }
 
+void KeyValueList::Assign(const int32* keys, const float* values,
+                          int32 size) {
+  keys_.assign(keys, keys + size);
+  values_.assign(values, values + size);
+  length_ = size;
+}
+
 int32 KeyValueList::Key(int32 index) {
   return keys_[index];
 }
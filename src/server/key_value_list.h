@@ -18,17 +18,54 @@ class KeyValueList {
   }
 
   void AddPair(int32 key, float value);
+  // Replace the list with size pairs copied from keys and values.
+  void Assign(const int32* keys, const float* values, int32 size);
   int32 Key(int32 index);
   float Value(int32 index);
   int32 Length();
+  const int32* Keys() const { return keys_.data(); }
+  const float* Values() const { return values_.data(); }
+
+  // Reorder the pairs stably so that those of a shard are together, where
+  // shard_of(key) is the shard of key in [0, shards). The pairs of shard s
+  // are then [ShardBegin(s), ShardBegin(s + 1)).
+  template <typename ShardOf>
+  void GroupByShard(int32 shards, const ShardOf& shard_of);
+  int32 ShardBegin(int32 shard) const { return shard_begin_[shard]; }
 
  private:
   int32 length_;
 
   std::vector<int32> keys_;
   std::vector<float> values_;
+  std::vector<int32> shard_begin_;
 };
 
+template <typename ShardOf>
+void KeyValueList::GroupByShard(int32 shards, const ShardOf& shard_of) {
+  std::vector<int32> shard(length_);
+  shard_begin_.assign(shards + 1, 0);
+  bool grouped = true;
+  for (int32 i = 0; i < length_; ++i) {
+    shard[i] = shard_of(keys_[i]);
+    shard_begin_[shard[i] + 1]++;
+    if (i > 0 && shard[i] < shard[i - 1]) grouped = false;
+  }
+  for (int32 s = 0; s < shards; ++s) shard_begin_[s + 1] += shard_begin_[s];
+  // Sorted keys, as the agents push, are already grouped.
+  if (grouped) return;
+  std::vector<int32> next(shard_begin_.begin(), shard_begin_.end() - 1);
+  std::vector<int32> keys(length_);
+  std::vector<float> values(length_);
+  for (int32 i = 0; i < length_; ++i) {
+    int32 pos = next[shard[i]]++;
+    keys[pos] = keys_[i];
+    values[pos] = values_[i];
+  }
+  keys_.swap(keys);
+  values_.swap(values);
+}
+
 }  // namespace rpscc
 
 #endif  // SRC_SERVER_KEY_VALUE_LIST_H_
@@ -0,0 +1,260 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "src/server/update_kernels.h"
+
+namespace rpscc {
+
+namespace {
+
+// Return value, or default_value if value is 0, i.e. not set in the config.
+float32 Or(float32 value, float32 default_value) {
+  return value != 0.0f ? value : default_value;
+}
+
+// StepOptimizer writes the sparse and the dense loops of an optimizer T
+// once, around the per-key T::Step(i, g, rate, parameters), which is
+// inlined into both. rate is T::Rate(step), the learning rate of the step,
+// computed once per update.
+template <typename T>
+class StepOptimizer : public Optimizer {
+ public:
+  void Apply(float32* parameters, float32* sums, float32 scale,
+             const int32* indices, int32 count, int32 step) override {
+    T* self = static_cast<T*>(this);
+    float32 rate = self->Rate(step);
+    for (int32 k = 0; k < count; ++k) {
+      int32 i = indices[k];
+      self->Step(i, sums[i] * scale, rate, parameters);
+      sums[i] = 0.0f;
+    }
+  }
+
+  // The words of marks with no bit set are skipped whole.
+  void ApplyDense(float32* parameters, float32* sums, const uint64* marks,
+                  float32 scale, int32 size, int32 step) override {
+    T* self = static_cast<T*>(this);
+    float32 rate = self->Rate(step);
+    for (int32 begin = 0; begin < size; begin += 64) {
+      uint64 word = marks[begin >> 6];
+      if (word == 0) continue;
+      int32 end = std::min(begin + 64, size);
+      for (int32 i = begin; i < end; ++i) {
+        if ((word >> (i & 63) & 1) == 0) continue;
+        self->Step(i, sums[i] * scale, rate, parameters);
+        sums[i] = 0.0f;
+      }
+    }
+  }
+
+  void ApplyValues(float32* parameters, const int32* indices,
+                   const float32* values, int32 count, float32 scale,
+                   int32 step) override {
+    T* self = static_cast<T*>(this);
+    float32 rate = self->Rate(step);
+    for (int32 k = 0; k < count; ++k)
+      self->Step(indices[k], values[k] * scale, rate, parameters);
+  }
+};
+
+class AddOptimizer : public Optimizer {
+ public:
+  void Resize(int32 length) override {}
+
+  void Apply(float32* parameters, float32* sums, float32 scale,
+             const int32* indices, int32 count, int32 step) override {
+    for (int32 k = 0; k < count; ++k) {
+      int32 i = indices[k];
+      parameters[i] += sums[i] * scale;
+      sums[i] = 0.0f;
+    }
+  }
+
+  // Adding the zero sums of the keys not pushed changes nothing.
+  void ApplyDense(float32* parameters, float32* sums, const uint64* marks,
+                  float32 scale, int32 size, int32 step) override {
+    Kernels().apply(parameters, sums, scale, size);
+  }
+
+  void ApplyValues(float32* parameters, const int32* indices,
+                   const float32* values, int32 count, float32 scale,
+                   int32 step) override {
+    for (int32 k = 0; k < count; ++k)
+      parameters[indices[k]] += values[k] * scale;
+  }
+
+  std::string name() const override { return "add"; }
+};
+
+class SgdOptimizer : public StepOptimizer<SgdOptimizer> {
+ public:
+  explicit SgdOptimizer(const Message_OptimizerConfig& config)
+      : learning_rate_(Or(config.learning_rate(), 0.01f)) {}
+
+  void Resize(int32 length) override {}
+
+  float32 Rate(int32 step) const { return learning_rate_; }
+  void Step(int32 i, float32 g, float32 rate, float32* parameters) {
+    parameters[i] -= rate * g;
+  }
+
+  std::string name() const override { return "sgd"; }
+
+ private:
+  float32 learning_rate_;
+};
+
+class MomentumOptimizer : public StepOptimizer<MomentumOptimizer> {
+ public:
+  explicit MomentumOptimizer(const Message_OptimizerConfig& config)
+      : learning_rate_(Or(config.learning_rate(), 0.01f)),
+        momentum_(Or(config.momentum(), 0.9f)) {}
+
+  void Resize(int32 length) override { velocity_.assign(length, 0.0f); }
+
+  float32 Rate(int32 step) const { return learning_rate_; }
+  void Step(int32 i, float32 g, float32 rate, float32* parameters) {
+    float32 v = momentum_ * velocity_[i] + g;
+    velocity_[i] = v;
+    parameters[i] -= rate * v;
+  }
+
+  std::string name() const override { return "momentum"; }
+  std::vector<std::vector<float32>*> StateArrays() override {
+    return {&velocity_};
+  }
+
+ private:
+  float32 learning_rate_;
+  float32 momentum_;
+  std::vector<float32> velocity_;
+};
+
+class AdagradOptimizer : public StepOptimizer<AdagradOptimizer> {
+ public:
+  explicit AdagradOptimizer(const Message_OptimizerConfig& config)
+      : learning_rate_(Or(config.learning_rate(), 0.01f)),
+        epsilon_(Or(config.epsilon(), 1e-8f)) {}
+
+  void Resize(int32 length) override { squares_.assign(length, 0.0f); }
+
+  float32 Rate(int32 step) const { return learning_rate_; }
+  void Step(int32 i, float32 g, float32 rate, float32* parameters) {
+    float32 h = squares_[i] + g * g;
+    squares_[i] = h;
+    parameters[i] -= rate * g / (std::sqrt(h) + epsilon_);
+  }
+
+  std::string name() const override { return "adagrad"; }
+  std::vector<std::vector<float32>*> StateArrays() override {
+    return {&squares_};
+  }
+
+ private:
+  float32 learning_rate_;
+  float32 epsilon_;
+  std::vector<float32> squares_;
+};
+
+class AdamOptimizer : public StepOptimizer<AdamOptimizer> {
+ public:
+  explicit AdamOptimizer(const Message_OptimizerConfig& config)
+      : learning_rate_(Or(config.learning_rate(), 0.001f)),
+        beta1_(Or(config.beta1(), 0.9f)),
+        beta2_(Or(config.beta2(), 0.999f)),
+        epsilon_(Or(config.epsilon(), 1e-8f)) {}
+
+  void Resize(int32 length) override {
+    first_.assign(length, 0.0f);
+    second_.assign(length, 0.0f);
+  }
+
+  // The bias correction of the step is folded into the rate.
+  float32 Rate(int32 step) const {
+    return learning_rate_ * std::sqrt(1.0f - std::pow(beta2_, step)) /
+           (1.0f - std::pow(beta1_, step));
+  }
+
+  void Step(int32 i, float32 g, float32 rate, float32* parameters) {
+    float32 m = beta1_ * first_[i] + (1.0f - beta1_) * g;
+    float32 v = beta2_ * second_[i] + (1.0f - beta2_) * g * g;
+    first_[i] = m;
+    second_[i] = v;
+    parameters[i] -= rate * m / (std::sqrt(v) + epsilon_);
+  }
+
+  std::string name() const override { return "adam"; }
+  std::vector<std::vector<float32>*> StateArrays() override {
+    return {&first_, &second_};
+  }
+
+ private:
+  float32 learning_rate_;
+  float32 beta1_;
+  float32 beta2_;
+  float32 epsilon_;
+  std::vector<float32> first_;
+  std::vector<float32> second_;
+};
+
+class FtrlOptimizer : public StepOptimizer<FtrlOptimizer> {
+ public:
+  explicit FtrlOptimizer(const Message_OptimizerConfig& config)
+      : alpha_(Or(config.learning_rate(), 0.05f)),
+        beta_(Or(config.beta(), 1.0f)),
+        l1_(config.l1()), l2_(config.l2()) {}
+
+  void Resize(int32 length) override {
+    z_.assign(length, 0.0f);
+    n_.assign(length, 0.0f);
+  }
+
+  float32 Rate(int32 step) const { return alpha_; }
+  void Step(int32 i, float32 g, float32 rate, float32* parameters) {
+    float32 n = n_[i];
+    float32 new_n = n + g * g;
+    float32 sigma = (std::sqrt(new_n) - std::sqrt(n)) / rate;
+    float32 z = z_[i] + g - sigma * parameters[i];
+    z_[i] = z;
+    n_[i] = new_n;
+    if (std::fabs(z) <= l1_) {
+      parameters[i] = 0.0f;
+    } else {
+      float32 sign = z < 0.0f ? -1.0f : 1.0f;
+      parameters[i] = -(z - sign * l1_) /
+                      ((beta_ + std::sqrt(new_n)) / rate + l2_);
+    }
+  }
+
+  std::string name() const override { return "ftrl"; }
+  std::vector<std::vector<float32>*> StateArrays() override {
+    return {&z_, &n_};
+  }
+
+ private:
+  float32 alpha_;
+  float32 beta_;
+  float32 l1_;
+  float32 l2_;
+  std::vector<float32> z_;
+  std::vector<float32> n_;
+};
+
+}  // namespace
+
+Optimizer* Optimizer::Create(const Message_OptimizerConfig& config) {
+  const std::string& name = config.name();
+  if (name.empty() || name == "add") return new AddOptimizer();
+  if (name == "sgd") return new SgdOptimizer(config);
+  if (name == "momentum") return new MomentumOptimizer(config);
+  if (name == "adagrad") return new AdagradOptimizer(config);
+  if (name == "adam") return new AdamOptimizer(config);
+  if (name == "ftrl") return new FtrlOptimizer(config);
+  return NULL;
+}
+
+}  // namespace rpscc
@@ -0,0 +1,75 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+#ifndef SRC_SERVER_OPTIMIZER_H_
+#define SRC_SERVER_OPTIMIZER_H_
+
+#include <string>
+#include <vector>
+
+#include "src/message/message.pb.h"
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// Optimizer applies the summed up pushes of a version to the parameters of
+// the shard. The state of an optimizer, e.g. the momentum or the second
+// moments, is kept in arrays as long as the shard, one array per quantity,
+// and each update is a single loop which reads and writes the parameter,
+// the sum and the state of a key once.
+//
+// The "add" optimizer adds the average of the pushes, which is what the
+// server did before optimizers, so workers push the deltas to be added. The
+// others take the average as the gradient and descend along it:
+//
+//   sgd       p -= lr * g
+//   momentum  v = momentum * v + g, p -= lr * v
+//   adagrad   h += g * g, p -= lr * g / (sqrt(h) + epsilon)
+//   adam      m = beta1 * m + (1 - beta1) * g,
+//             v = beta2 * v + (1 - beta2) * g * g,
+//             p -= lr * sqrt(1 - beta2^t) / (1 - beta1^t) * m /
+//                  (sqrt(v) + epsilon)
+//   ftrl      FTRL-proximal with per-key z and n, see McMahan et al., "Ad
+//             Click Prediction: a View from the Trenches".
+//
+// Only the keys pushed in a version are updated, so adam and momentum are
+// lazy: the state of a key decays only in the versions in which it is
+// pushed. t is the step of the update, which the server counts for all its
+// shards, so an optimizer keeps no state but the arrays, and the shards
+// agree on t whichever of them a version touches.
+class Optimizer {
+ public:
+  virtual ~Optimizer() {}
+
+  // Create the optimizer of config, or return NULL if the name is unknown.
+  static Optimizer* Create(const Message_OptimizerConfig& config);
+
+  // Set the length of the shard. The state is reset.
+  virtual void Resize(int32 length) = 0;
+
+  // Update parameters[i] with the gradient sums[i] * scale for every i in
+  // indices, as the step-th update since Resize(), counting from 1, and set
+  // sums[i] to 0.
+  virtual void Apply(float32* parameters, float32* sums, float32 scale,
+                     const int32* indices, int32 count, int32 step) = 0;
+  // The same for every i in [0, size) pushed in the version, whose bit
+  // i % 64 of marks[i / 64] is set. The sums of the others are 0, but an
+  // optimizer with state must not step them.
+  virtual void ApplyDense(float32* parameters, float32* sums,
+                          const uint64* marks, float32 scale, int32 size,
+                          int32 step) = 0;
+  // Update parameters[indices[k]] with the gradient values[k] * scale for
+  // every k in [0, count), as the step-th update. It is used to apply a
+  // push on arrival, without summing it up.
+  virtual void ApplyValues(float32* parameters, const int32* indices,
+                           const float32* values, int32 count, float32 scale,
+                           int32 step) = 0;
+
+  virtual std::string name() const = 0;
+
+  // The state for a checkpoint, arrays as long as the shard. Restoring a
+  // checkpoint writes them.
+  virtual std::vector<std::vector<float32>*> StateArrays() { return {}; }
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_OPTIMIZER_H_
@@ -0,0 +1,185 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/server/optimizer.h"
+
+using namespace rpscc;
+
+namespace {
+
+Optimizer* Create(const std::string& name, float32 learning_rate = 0.0f) {
+  Message_OptimizerConfig config;
+  config.set_name(name);
+  config.set_learning_rate(learning_rate);
+  return Optimizer::Create(config);
+}
+
+}  // namespace
+
+TEST(Optimizer, Create) {
+  for (std::string name : {"", "add", "sgd", "momentum", "adagrad", "adam",
+                           "ftrl"}) {
+    std::unique_ptr<Optimizer> optimizer(Create(name));
+    ASSERT_TRUE(optimizer != NULL) << name;
+    if (!name.empty()) EXPECT_EQ(name, optimizer->name());
+  }
+  EXPECT_TRUE(Create("lbfgs") == NULL);
+}
+
+TEST(Optimizer, Steps) {
+  std::vector<float32> parameters(1, 1.0f), sums(1);
+  int32 index = 0;
+
+  std::unique_ptr<Optimizer> add(Create("add"));
+  add->Resize(1);
+  sums[0] = 4.0f;
+  add->Apply(parameters.data(), sums.data(), 0.5f, &index, 1, 1);
+  EXPECT_FLOAT_EQ(3.0f, parameters[0]);
+  EXPECT_EQ(0.0f, sums[0]);
+
+  std::unique_ptr<Optimizer> sgd(Create("sgd", 0.1f));
+  sgd->Resize(1);
+  sums[0] = 4.0f;
+  sgd->Apply(parameters.data(), sums.data(), 0.5f, &index, 1, 1);
+  EXPECT_FLOAT_EQ(2.8f, parameters[0]);
+
+  std::unique_ptr<Optimizer> momentum(Create("momentum", 0.1f));
+  momentum->Resize(1);
+  for (int32 t = 0; t < 2; ++t) {
+    sums[0] = 1.0f;
+    momentum->Apply(parameters.data(), sums.data(), 1.0f, &index, 1, t + 1);
+  }
+  // v = 1, then 0.9 + 1
+  EXPECT_FLOAT_EQ(2.8f - 0.1f - 0.19f, parameters[0]);
+
+  std::unique_ptr<Optimizer> adagrad(Create("adagrad", 0.1f));
+  adagrad->Resize(1);
+  parameters[0] = 1.0f;
+  for (int32 t = 0; t < 2; ++t) {
+    sums[0] = 2.0f;
+    adagrad->Apply(parameters.data(), sums.data(), 1.0f, &index, 1, t + 1);
+  }
+  EXPECT_FLOAT_EQ(1.0f - 0.1f - 0.1f * 2.0f / std::sqrt(8.0f),
+                  parameters[0]);
+
+  // The first step of adam moves by the learning rate.
+  std::unique_ptr<Optimizer> adam(Create("adam", 0.1f));
+  adam->Resize(1);
+  parameters[0] = 1.0f;
+  sums[0] = 3.0f;
+  adam->Apply(parameters.data(), sums.data(), 1.0f, &index, 1, 1);
+  EXPECT_NEAR(0.9f, parameters[0], 1e-6);
+  // The bias correction is of the step given, not of the number of updates
+  // the optimizer has made: m = 0.1 * g, v = 0.001 * g^2.
+  std::unique_ptr<Optimizer> late(Create("adam", 0.1f));
+  late->Resize(1);
+  parameters[0] = 1.0f;
+  sums[0] = 3.0f;
+  late->Apply(parameters.data(), sums.data(), 1.0f, &index, 1, 3);
+  float32 rate = 0.1f * std::sqrt(1.0f - std::pow(0.999f, 3)) /
+                 (1.0f - std::pow(0.9f, 3));
+  EXPECT_NEAR(1.0f - rate * 0.3f / std::sqrt(0.009f), parameters[0], 1e-6);
+
+  // The first step of ftrl: n = g^2, z = g - |g| / alpha * w.
+  std::unique_ptr<Optimizer> ftrl(Create("ftrl", 0.5f));
+  ftrl->Resize(1);
+  parameters[0] = 0.0f;
+  sums[0] = 2.0f;
+  ftrl->Apply(parameters.data(), sums.data(), 1.0f, &index, 1, 1);
+  EXPECT_FLOAT_EQ(-2.0f / ((1.0f + 2.0f) / 0.5f), parameters[0]);
+}
+
+TEST(Optimizer, SparseMatchesDense) {
+  const int32 kLength = 100;
+  for (std::string name : {"add", "sgd", "momentum", "adagrad", "adam",
+                           "ftrl"}) {
+    std::unique_ptr<Optimizer> sparse(Create(name)), dense(Create(name));
+    sparse->Resize(kLength);
+    dense->Resize(kLength);
+    std::vector<float32> sparse_parameters(kLength, 0.5f);
+    std::vector<float32> dense_parameters(kLength, 0.5f);
+    std::vector<int32> indices(kLength);
+    for (int32 i = 0; i < kLength; ++i) indices[i] = i;
+    std::vector<uint64> marks((kLength + 63) / 64, ~0ull);
+    for (int32 version = 0; version < 5; ++version) {
+      std::vector<float32> sparse_sums(kLength), dense_sums(kLength);
+      for (int32 i = 0; i < kLength; ++i)
+        sparse_sums[i] = dense_sums[i] = (i % 7) - 3.0f + version;
+      sparse->Apply(sparse_parameters.data(), sparse_sums.data(), 0.5f,
+                    indices.data(), kLength, version + 1);
+      dense->ApplyDense(dense_parameters.data(), dense_sums.data(),
+                        marks.data(), 0.5f, kLength, version + 1);
+      EXPECT_EQ(std::vector<float32>(kLength, 0.0f), dense_sums);
+    }
+    for (int32 i = 0; i < kLength; ++i)
+      EXPECT_NEAR(sparse_parameters[i], dense_parameters[i], 1e-6)
+          << name << " at " << i;
+  }
+}
+
+// A dense sweep steps only the keys marked as pushed, however many there
+// are, so the state of the others, e.g. the velocity of momentum, does not
+// decay and their parameters do not move.
+TEST(Optimizer, DenseSkipsUnmarked) {
+  const int32 kLength = 150;
+  for (std::string name : {"add", "sgd", "momentum", "adagrad", "adam",
+                           "ftrl"}) {
+    std::unique_ptr<Optimizer> sparse(Create(name)), dense(Create(name));
+    sparse->Resize(kLength);
+    dense->Resize(kLength);
+    std::vector<float32> sparse_parameters(kLength, 0.5f);
+    std::vector<float32> dense_parameters(kLength, 0.5f);
+    for (int32 version = 0; version < 5; ++version) {
+      std::vector<int32> indices;
+      std::vector<float32> sparse_sums(kLength), dense_sums(kLength);
+      std::vector<uint64> marks((kLength + 63) / 64, 0);
+      // All keys in the first version, then every third one from version,
+      // and none in the second word.
+      for (int32 i = 0; i < kLength; ++i) {
+        if (version > 0 && ((i - version) % 3 != 0 || i / 64 == 1)) continue;
+        indices.push_back(i);
+        marks[i / 64] |= 1ull << (i % 64);
+        sparse_sums[i] = dense_sums[i] = (i % 5) - 2.0f + version;
+      }
+      sparse->Apply(sparse_parameters.data(), sparse_sums.data(), 0.5f,
+                    indices.data(), indices.size(), version + 1);
+      dense->ApplyDense(dense_parameters.data(), dense_sums.data(),
+                        marks.data(), 0.5f, kLength, version + 1);
+    }
+    for (int32 i = 0; i < kLength; ++i)
+      EXPECT_NEAR(sparse_parameters[i], dense_parameters[i], 1e-6)
+          << name << " at " << i;
+  }
+}
+
+TEST(Optimizer, ValuesMatchSums) {
+  const int32 kLength = 50;
+  for (std::string name : {"add", "sgd", "momentum", "adagrad", "adam",
+                           "ftrl"}) {
+    std::unique_ptr<Optimizer> sums(Create(name)), values(Create(name));
+    sums->Resize(kLength);
+    values->Resize(kLength);
+    std::vector<float32> sums_parameters(kLength, 0.5f);
+    std::vector<float32> values_parameters(kLength, 0.5f);
+    for (int32 version = 0; version < 5; ++version) {
+      std::vector<int32> indices;
+      std::vector<float32> pushed, version_sums(kLength);
+      for (int32 i = version; i < kLength; i += 3) {
+        indices.push_back(i);
+        pushed.push_back((i % 5) - 2.0f + version);
+        version_sums[i] = pushed.back();
+      }
+      sums->Apply(sums_parameters.data(), version_sums.data(), 0.5f,
+                  indices.data(), indices.size(), version + 1);
+      values->ApplyValues(values_parameters.data(), indices.data(),
+                          pushed.data(), indices.size(), 0.5f, version + 1);
+    }
+    for (int32 i = 0; i < kLength; ++i)
+      EXPECT_NEAR(sums_parameters[i], values_parameters[i], 1e-6)
+          << name << " at " << i;
+  }
+}
@@ -0,0 +1,40 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/parameter_shard.h"
+
+namespace rpscc {
+
+bool ParameterShard::Initialize(int32 begin, int32 end, int32 versions,
+                                const Message_OptimizerConfig& config) {
+  optimizer_.reset(Optimizer::Create(config));
+  if (optimizer_ == NULL) return false;
+  begin_ = begin;
+  end_ = end;
+  versions_.resize(versions);
+  for (auto& version : versions_) version.Resize(end - begin);
+  optimizer_->Resize(end - begin);
+  return true;
+}
+
+void ParameterShard::ApplyValues(const int32* indices, const float32* values,
+                                 int32 count, float32 scale, int32 step,
+                                 float32* parameters, int32* modified,
+                                 int32 applied_version) {
+  std::vector<int32> local(count);
+  for (int32 k = 0; k < count; ++k) local[k] = indices[k] - begin_;
+  optimizer_->ApplyValues(parameters + begin_, local.data(), values, count,
+                          scale, step);
+  // A pull which sees the version of a key sees its value too. The pushes
+  // to a shard may be applied out of order, and with --hogwild at once, so
+  // the version of a key only grows.
+  for (int32 k = 0; k < count; ++k) {
+    int32* version = modified + indices[k];
+    int32 old = __atomic_load_n(version, __ATOMIC_RELAXED);
+    while (old < applied_version &&
+           !__atomic_compare_exchange_n(version, &old, applied_version, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+  }
+}
+
+}  // namespace rpscc
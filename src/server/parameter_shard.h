@@ -0,0 +1,83 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+#ifndef SRC_SERVER_PARAMETER_SHARD_H_
+#define SRC_SERVER_PARAMETER_SHARD_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "src/message/message.pb.h"
+#include "src/server/optimizer.h"
+#include "src/server/update_accumulator.h"
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// ParameterShard owns the contiguous range [begin, end) of the indices of
+// the server's parameters_, together with the sums of the pushes to it and
+// the state of its optimizer. The server splits its parameters into one
+// shard per thread. The pushes to a shard are added to its sums, or under
+// ASP applied to it, by whichever threads of the pool run them, so they
+// hold mutex(), except for the pushes --hogwild applies. The replies to
+// pulls read the shard under mutex() too while pushes are applied to it.
+// Applying the sums of a version takes no lock: the server waits for the
+// pushes and the replies first, and no two shards share an index.
+// The pushes are summed up as they arrive, with one accumulator per version
+// in the consistency bound, so a shard holds at most bound sums of its
+// length however many agents push to it.
+class ParameterShard {
+ public:
+  ParameterShard() : begin_(0), end_(0) {}
+
+  // Return false if the optimizer of config is unknown.
+  bool Initialize(int32 begin, int32 end, int32 versions,
+                  const Message_OptimizerConfig& config);
+
+  int32 begin() const { return begin_; }
+  int32 end() const { return end_; }
+
+  // Add values[i] to the sum of index + i in the accumulator of version,
+  // where [index, index + size) lies in the shard. Pushes to a shard may be
+  // added by several threads, which hold mutex().
+  void AddRun(int32 version, int32 index, const float32* values,
+              int32 size) {
+    versions_[version].AddRun(index - begin_, values, size);
+  }
+  std::mutex* mutex() { return &mutex_; }
+
+  // Apply values[k] times scale to the parameter indices[k] at once, for
+  // the count pairs of a push to the shard, as the step-th update of the
+  // optimizer, and then raise the modified of them to applied_version.
+  void ApplyValues(const int32* indices, const float32* values, int32 count,
+                   float32 scale, int32 step, float32* parameters,
+                   int32* modified, int32 applied_version);
+  Optimizer* optimizer() { return optimizer_.get(); }
+
+  // Apply the sums of version times scale to the shard's range of
+  // parameters, as the step-th update of the optimizer, and clear them.
+  // modified[i] is set to applied_version for the parameters i which are
+  // changed, and the indices i are put in changed in increasing order
+  // unless it is NULL.
+  void Apply(int32 version, float32* parameters, float32 scale, int32 step,
+             int32* modified, int32 applied_version,
+             std::vector<int32>* changed) {
+    versions_[version].MarkTouched(modified + begin_, applied_version);
+    if (changed != NULL) {
+      changed->clear();
+      versions_[version].AppendTouched(begin_, changed);
+    }
+    versions_[version].ApplyTo(parameters + begin_, scale, optimizer_.get(),
+                               step);
+  }
+
+ private:
+  int32 begin_;
+  int32 end_;
+  std::vector<UpdateAccumulator> versions_;
+  std::unique_ptr<Optimizer> optimizer_;
+  std::mutex mutex_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_PARAMETER_SHARD_H_
@@ -0,0 +1,62 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/server/parameter_shard.h"
+
+using namespace rpscc;
+
+namespace {
+
+const int32 kLength = 64;
+const int32 kThreads = 4;
+const int32 kPushes = 500;
+
+// Apply the p-th push of thread t, a pair with a key of its own quarter of
+// the shard, as the step the server would give it.
+void Push(ParameterShard* shard, float32* parameters, int32* modified,
+          int32 t, int32 p) {
+  int32 index = t * (kLength / kThreads) + p % (kLength / kThreads);
+  float32 value = (p % 7) - 3.0f;
+  int32 step = p * kThreads + t + 1;
+  shard->ApplyValues(&index, &value, 1, 0.5f, step, parameters, modified,
+                     step);
+}
+
+}  // namespace
+
+// Pushes applied to a shard by several threads at once without its lock, as
+// with --hogwild, give the parameters the same pushes give one by one when
+// they touch different keys: the optimizers share no state between keys.
+TEST(ParameterShard, ConcurrentValues) {
+  for (std::string name : {"add", "sgd", "momentum", "adagrad", "adam",
+                           "ftrl"}) {
+    Message_OptimizerConfig config;
+    config.set_name(name);
+    ParameterShard concurrent, serial;
+    ASSERT_TRUE(concurrent.Initialize(0, kLength, 1, config));
+    ASSERT_TRUE(serial.Initialize(0, kLength, 1, config));
+    std::vector<float32> concurrent_parameters(kLength, 0.5f);
+    std::vector<float32> serial_parameters(kLength, 0.5f);
+    std::vector<int32> concurrent_modified(kLength), serial_modified(kLength);
+
+    std::vector<std::thread> threads;
+    for (int32 t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&, t] {
+        for (int32 p = 0; p < kPushes; ++p)
+          Push(&concurrent, concurrent_parameters.data(),
+               concurrent_modified.data(), t, p);
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    for (int32 p = 0; p < kPushes; ++p)
+      for (int32 t = 0; t < kThreads; ++t)
+        Push(&serial, serial_parameters.data(), serial_modified.data(), t, p);
+
+    EXPECT_EQ(serial_parameters, concurrent_parameters) << name;
+    EXPECT_EQ(serial_modified, concurrent_modified) << name;
+  }
+}
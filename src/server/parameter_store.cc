@@ -0,0 +1,34 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/parameter_store.h"
+
+#include <utility>
+
+namespace rpscc {
+
+void ParameterStore::Assign(size_t size, float32 value) {
+  checkpoint_.reset();
+  owned_.assign(size, value);
+  data_ = owned_.data();
+  size_ = size;
+}
+
+void ParameterStore::Map(std::unique_ptr<MappedCheckpoint> checkpoint) {
+  owned_.clear();
+  owned_.shrink_to_fit();
+  checkpoint_ = std::move(checkpoint);
+  data_ = checkpoint_->values();
+  size_ = checkpoint_->header().length;
+}
+
+void ParameterStore::Prepend(const std::vector<float32>& values) {
+  if (mapped()) {
+    owned_.assign(begin(), end());
+    checkpoint_.reset();
+  }
+  owned_.insert(owned_.begin(), values.begin(), values.end());
+  data_ = owned_.data();
+  size_ = owned_.size();
+}
+
+}  // namespace rpscc
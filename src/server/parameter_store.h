@@ -0,0 +1,50 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#ifndef SRC_SERVER_PARAMETER_STORE_H_
+#define SRC_SERVER_PARAMETER_STORE_H_
+
+#include <memory>
+#include <vector>
+
+#include "src/server/checkpoint.h"
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// ParameterStore holds the parameters of a server, either in memory it owns
+// or in the values of a checkpoint it maps. A server restarted from a
+// checkpoint serves it right away: the pages are read from the file as
+// they are touched, and as the mapping is private, the pages the server
+// updates are copied on write and the file stays unchanged.
+class ParameterStore {
+ public:
+  ParameterStore() : data_(NULL), size_(0) {}
+
+  // Own size parameters set to value.
+  void Assign(size_t size, float32 value);
+  // Use the values of checkpoint, and keep it mapped.
+  void Map(std::unique_ptr<MappedCheckpoint> checkpoint);
+  // Put values before the parameters. A mapped store is copied into memory
+  // first.
+  void Prepend(const std::vector<float32>& values);
+
+  bool mapped() const { return checkpoint_ != NULL; }
+
+  float32* data() { return data_; }
+  const float32* data() const { return data_; }
+  size_t size() const { return size_; }
+  float32& operator[](size_t i) { return data_[i]; }
+  const float32& operator[](size_t i) const { return data_[i]; }
+  const float32* begin() const { return data_; }
+  const float32* end() const { return data_ + size_; }
+
+ private:
+  std::vector<float32> owned_;
+  std::unique_ptr<MappedCheckpoint> checkpoint_;
+  float32* data_;
+  size_t size_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_PARAMETER_STORE_H_
@@ -0,0 +1,51 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/server/parameter_store.h"
+
+using namespace rpscc;
+
+TEST(ParameterStore, Assign) {
+  ParameterStore store;
+  store.Assign(3, 1.5f);
+  EXPECT_FALSE(store.mapped());
+  ASSERT_EQ(3, store.size());
+  store[1] = 2.0f;
+  EXPECT_EQ(std::vector<float32>({1.5f, 2.0f, 1.5f}),
+            std::vector<float32>(store.begin(), store.end()));
+  store.Prepend({0.5f});
+  EXPECT_EQ(std::vector<float32>({0.5f, 1.5f, 2.0f, 1.5f}),
+            std::vector<float32>(store.begin(), store.end()));
+}
+
+TEST(ParameterStore, Map) {
+  std::string path = testing::TempDir() + "parameter_store_gtest.ckpt";
+  Checkpoint checkpoint;
+  checkpoint.version = 3;
+  checkpoint.start_key = 0;
+  checkpoint.key_range = 4;
+  checkpoint.steps = 3;
+  checkpoint.values = {1.0f, 2.0f, 3.0f, 4.0f};
+  ASSERT_TRUE(checkpoint.Write(path));
+
+  std::unique_ptr<MappedCheckpoint> mapped(new MappedCheckpoint());
+  ASSERT_TRUE(mapped->Open(path));
+  ParameterStore store;
+  store.Map(std::move(mapped));
+  EXPECT_TRUE(store.mapped());
+  ASSERT_EQ(4, store.size());
+  store[0] += 1.0f;
+  EXPECT_EQ(2.0f, store[0]);
+  // Prepending copies the mapped values.
+  store.Prepend({0.0f});
+  EXPECT_FALSE(store.mapped());
+  EXPECT_EQ(std::vector<float32>({0.0f, 2.0f, 2.0f, 3.0f, 4.0f}),
+            std::vector<float32>(store.begin(), store.end()));
+  remove(path.c_str());
+}
@@ -11,11 +11,23 @@ void PullInfo::AddKey(int32 key) {
   length_++;
 }
 
-int32 PullInfo::Key(int32 index) {
-  return keys_[index];
+void PullInfo::AssignKeys(const int32* keys, int32 size) {
+  keys_.assign(keys, keys + size);
+  length_ = size;
 }
 
-int32 PullInfo::Length() {
+void PullInfo::SetRange(int32 start_key, int32 length) {
+  keys_.clear();
+  range_ = true;
+  start_key_ = start_key;
+  length_ = length;
+}
+
+int32 PullInfo::Key(int32 index) const {
+  return range_ ? start_key_ + index : keys_[index];
+}
+
+int32 PullInfo::Length() const {
   return length_;
 }
 
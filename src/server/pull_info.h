@@ -15,20 +15,62 @@ class PullInfo {
   PullInfo() {
     length_ = 0;
     id_ = 0;
+    binary_ = false;
+    range_ = false;
+    start_key_ = 0;
+    delta_ = false;
+    since_version_ = 0;
   }
-  int32 Length();
+  int32 Length() const;
   void AddKey(int32 key);
-  int32 Key(int32 index);
-  int32 get_id() {
+  // Replace the keys with size keys copied from keys.
+  void AssignKeys(const int32* keys, int32 size);
+  // Make it a pull of the keys [start_key, start_key + length), whose keys
+  // are not stored.
+  void SetRange(int32 start_key, int32 length);
+  bool range() const {
+    return range_;
+  }
+  int32 start_key() const {
+    return start_key_;
+  }
+  // Make it a delta pull of the keys changed after since_version.
+  void SetDelta(int32 since_version) {
+    delta_ = true;
+    since_version_ = since_version;
+  }
+  bool delta() const {
+    return delta_;
+  }
+  int32 since_version() const {
+    return since_version_;
+  }
+  const int32* Keys() const {
+    return keys_.data();
+  }
+  int32 Key(int32 index) const;
+  int32 get_id() const {
     return id_;
   }
   void set_id(int32 id) {
     id_ = id;
   }
+  // Whether the request uses the binary payload.
+  bool binary() const {
+    return binary_;
+  }
+  void set_binary(bool binary) {
+    binary_ = binary;
+  }
 
  private:
   int32 length_;
   int32 id_;
+  bool binary_;
+  bool range_;
+  int32 start_key_;
+  bool delta_;
+  int32 since_version_;
 
   std::vector<int32> keys_;
 };
@@ -0,0 +1,77 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/reply_cache.h"
+
+#include <cstring>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "src/message/message.pb.h"
+
+namespace rpscc {
+
+void ReplyCache::Reset(size_t max_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  max_bytes_ = max_bytes;
+  bytes_ = 0;
+}
+
+std::shared_ptr<const std::string> ReplyCache::Get(const int32* keys,
+                                                   int32 size, int32 format,
+                                                   const Builder& build) {
+  uint64 fingerprint = Fingerprint(keys, size, format);
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(fingerprint);
+    if (it != entries_.end()) {
+      entry = it->second;
+    } else if (bytes_ < max_bytes_) {
+      entry.reset(new Entry());
+      entry->keys.assign(keys, keys + size);
+      entry->format = format;
+      entries_[fingerprint] = entry;
+    }
+  }
+  // Two key lists may share a fingerprint, the keys decide.
+  if (entry != NULL && entry->format == format &&
+      entry->keys.size() == size &&
+      memcmp(entry->keys.data(), keys, size * sizeof(int32)) == 0) {
+    std::call_once(entry->built, [this, &entry, &build] {
+      std::string* reply = new std::string();
+      build(reply);
+      entry->reply.reset(reply);
+      std::lock_guard<std::mutex> lock(mutex_);
+      bytes_ += reply->size();
+    });
+    return entry->reply;
+  }
+  std::string* reply = new std::string();
+  build(reply);
+  return std::shared_ptr<const std::string>(reply);
+}
+
+uint64 ReplyCache::Fingerprint(const int32* keys, int32 size, int32 format) {
+  uint64 hash = 0xcbf29ce484222325ULL ^
+                (static_cast<uint64>(size) << 32 | static_cast<uint32>(format));
+  for (int32 i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<uint32>(keys[i])) * 0x100000001b3ULL;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+void AppendRequestMessage(const std::string& request, std::string* message) {
+  using google::protobuf::internal::WireFormatLite;
+  google::protobuf::io::StringOutputStream stream(message);
+  google::protobuf::io::CodedOutputStream output(&stream);
+  output.WriteTag(WireFormatLite::MakeTag(
+      Message::kRequestMsgFieldNumber,
+      WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+  output.WriteVarint32(request.size());
+  output.WriteRaw(request.data(), request.size());
+}
+
+}  // namespace rpscc
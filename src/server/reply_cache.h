@@ -0,0 +1,69 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#ifndef SRC_SERVER_REPLY_CACHE_H_
+#define SRC_SERVER_REPLY_CACHE_H_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// ReplyCache keeps the serialized RequestMessage of the replies to pulls of
+// the current parameter version, by the fingerprint of the pulled keys and
+// the format of the reply. In BSP every agent pulls the same keys after an
+// update, so the reply is gathered and encoded once per version instead of
+// once per agent, and only the small Message around it is serialized per
+// agent, see AppendRequestMessage.
+// The replies are built in the threads of the server's pool: a reply being
+// built by one thread is waited for by the others which need it. The cache
+// is cleared by Reset() when the version changes, and replies built while
+// more than max_bytes are cached are not kept.
+class ReplyCache {
+ public:
+  typedef std::function<void(std::string*)> Builder;
+
+  explicit ReplyCache(size_t max_bytes = 0) : max_bytes_(max_bytes),
+                                              bytes_(0) {}
+
+  // Drop the replies, and cache at most max_bytes of them from now on.
+  void Reset(size_t max_bytes);
+
+  // Return the reply to a pull of size keys, which build writes into its
+  // argument if it is not cached. Replies to the same keys in different
+  // formats are told apart by format, which is up to the caller.
+  std::shared_ptr<const std::string> Get(const int32* keys, int32 size,
+                                         int32 format, const Builder& build);
+
+  size_t bytes() const { return bytes_; }
+
+  static uint64 Fingerprint(const int32* keys, int32 size, int32 format);
+
+ private:
+  struct Entry {
+    std::vector<int32> keys;
+    int32 format;
+    std::once_flag built;
+    std::shared_ptr<const std::string> reply;
+  };
+
+  std::mutex mutex_;
+  size_t max_bytes_;
+  size_t bytes_;
+  std::unordered_map<uint64, std::shared_ptr<Entry>> entries_;
+};
+
+// Append request, a serialized RequestMessage, to message, a serialized
+// Message without request_msg, as its request_msg field. Protobuf parses
+// the fields of a message in any order, so the result is the serialization
+// of the Message with request_msg set.
+void AppendRequestMessage(const std::string& request, std::string* message);
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_REPLY_CACHE_H_
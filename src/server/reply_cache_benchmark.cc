@@ -0,0 +1,83 @@
+// Copyright (c) 2019 The RPSCC Authors. All rights reserved.
+//
+// Benchmark for the reply cache of the server. As in BSP, every agent
+// pulls the same keys after an update, and the replies to all of them are
+// built the way Server::SchedulePullReply builds them: gathering the values,
+// encoding the RequestMessage and serializing the Message, once per agent
+// without the cache, and once per version with it. The CPU time of the
+// replies to all agents of a version is reported.
+//
+// Usage: ./reply_cache_benchmark --agents=64 --keys=1000000
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "src/message/key_value_codec.h"
+#include "src/message/message.pb.h"
+#include "src/server/reply_cache.h"
+
+DEFINE_int32(agents, 64, "Number of agents pulling in a version.");
+DEFINE_int32(keys, 1000000, "Number of keys pulled by every agent.");
+DEFINE_int32(versions, 5, "Number of versions replied to.");
+
+using namespace rpscc;
+
+namespace {
+
+// Return the seconds spent on the replies to all agents in a version.
+double Run(const std::vector<int32>& keys,
+           const std::vector<float32>& parameters, bool cached) {
+  ReplyCache cache;
+  size_t bytes = 0;
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  for (int32 version = 0; version < FLAGS_versions; version++) {
+    cache.Reset(cached ? size_t(1) << 30 : 0);
+    for (int32 agent = 0; agent < FLAGS_agents; agent++) {
+      std::shared_ptr<const std::string> reply = cache.Get(
+          keys.data(), keys.size(), 1, [&](std::string* reply) {
+        Message_RequestMessage reply_msg;
+        std::vector<float32> values(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+          values[i] = parameters[keys[i]];
+        SetKeyValues(keys.data(), values.data(), keys.size(), true, true,
+                     &reply_msg);
+        reply_msg.SerializeToString(reply);
+      });
+      std::string reply_str;
+      Message msg_send;
+      msg_send.set_send_id(0);
+      msg_send.set_recv_id(agent);
+      msg_send.set_message_type(Message_MessageType_request);
+      msg_send.SerializeToString(&reply_str);
+      AppendRequestMessage(*reply, &reply_str);
+      bytes += reply_str.size();
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+  if (bytes == 0) printf("no reply\n");
+  return seconds / FLAGS_versions;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  // Sorted keys with gaps, as a pull of a sparse model.
+  std::vector<int32> keys(FLAGS_keys);
+  for (int32 i = 0; i < FLAGS_keys; i++) keys[i] = 3 * i;
+  std::vector<float32> parameters(3 * FLAGS_keys, 0.25f);
+
+  double uncached = Run(keys, parameters, false);
+  double cached = Run(keys, parameters, true);
+  printf("agents = %d, keys = %d\n", FLAGS_agents, FLAGS_keys);
+  printf("  every reply built  %9.2f ms per version\n", uncached * 1e3);
+  printf("  reply cache        %9.2f ms per version, %.1fx\n", cached * 1e3,
+         uncached / cached);
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/message/message.pb.h"
+#include "src/server/reply_cache.h"
+#include "src/util/thread_pool.h"
+
+using namespace rpscc;
+
+TEST(ReplyCache, BuildsOncePerKeys) {
+  ReplyCache cache(1 << 20);
+  std::vector<int32> keys = {1, 2, 3}, other = {1, 2, 4};
+  int32 builds = 0;
+  ReplyCache::Builder build = [&](std::string* reply) {
+    *reply = "reply " + std::to_string(builds++);
+  };
+  EXPECT_EQ("reply 0", *cache.Get(keys.data(), 3, 1, build));
+  EXPECT_EQ("reply 0", *cache.Get(keys.data(), 3, 1, build));
+  EXPECT_EQ("reply 1", *cache.Get(other.data(), 3, 1, build));
+  // The format is part of the reply.
+  EXPECT_EQ("reply 2", *cache.Get(keys.data(), 3, 0, build));
+  EXPECT_EQ("reply 0", *cache.Get(keys.data(), 3, 1, build));
+
+  // A new version.
+  cache.Reset(1 << 20);
+  EXPECT_EQ("reply 3", *cache.Get(keys.data(), 3, 1, build));
+  EXPECT_EQ(4, builds);
+  EXPECT_EQ(7, cache.bytes());
+}
+
+TEST(ReplyCache, Full) {
+  ReplyCache cache(0);
+  std::vector<int32> keys = {5};
+  int32 builds = 0;
+  ReplyCache::Builder build = [&](std::string* reply) {
+    *reply = std::to_string(builds++);
+  };
+  EXPECT_EQ("0", *cache.Get(keys.data(), 1, 1, build));
+  EXPECT_EQ("1", *cache.Get(keys.data(), 1, 1, build));
+}
+
+TEST(ReplyCache, Threads) {
+  ReplyCache cache(1 << 20);
+  std::vector<int32> keys(1000, 7);
+  std::atomic<int32> builds(0);
+  ThreadPool pool(4);
+  for (int32 i = 0; i < 100; ++i) {
+    pool.Schedule([&] {
+      std::shared_ptr<const std::string> reply =
+          cache.Get(keys.data(), keys.size(), 1, [&](std::string* reply) {
+            builds++;
+            *reply = "reply";
+          });
+      EXPECT_EQ("reply", *reply);
+    });
+  }
+  pool.Wait();
+  EXPECT_EQ(1, builds);
+}
+
+TEST(ReplyCache, AppendRequestMessage) {
+  Message_RequestMessage request;
+  request.set_request_type(Message_RequestMessage_RequestType_key_value);
+  request.add_keys(3);
+  request.add_values(0.5f);
+  std::string request_str;
+  request.SerializeToString(&request_str);
+
+  Message msg;
+  msg.set_send_id(1);
+  msg.set_recv_id(2);
+  msg.set_message_type(Message_MessageType_request);
+  std::string msg_str;
+  msg.SerializeToString(&msg_str);
+  AppendRequestMessage(request_str, &msg_str);
+
+  Message parsed;
+  ASSERT_TRUE(parsed.ParseFromString(msg_str));
+  EXPECT_EQ(1, parsed.send_id());
+  EXPECT_EQ(2, parsed.recv_id());
+  EXPECT_EQ(Message_MessageType_request, parsed.message_type());
+  ASSERT_EQ(1, parsed.request_msg().keys_size());
+  EXPECT_EQ(3, parsed.request_msg().keys(0));
+  EXPECT_EQ(0.5f, parsed.request_msg().values(0));
+}
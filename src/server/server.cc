@@ -1,9 +1,15 @@
 // Copyright 2018 The RPSCC Authors. All Rights Reserved.
 // Author : Xu Song (sazel.sekibanki@gmail.com)
 
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "gflags/gflags.h"
+#include "src/message/key_value_codec.h"
 #include "src/server/server.h"
 #include "src/util/logging.h"
 #include "src/util/network_util.h"
@@ -21,6 +27,25 @@ DEFINE_int32(server_port, 8888, "Port used by the server receiver.");
 DEFINE_int32(ring_size, 64, "Size of communicator's message queue.");
 DEFINE_int32(buffer_size, 2048, "Size of each message's buffer.");
 DEFINE_string(master_ip_port, "", "IP and Port of the first master node.");
+DEFINE_int32(reply_cache_mb, 256, "Megabytes of pull replies kept for the "
+             "other agents pulling the same keys in a version, 0 to build "
+             "every reply.");
+DEFINE_int32(server_threads, 4, "Number of threads updating the parameter "
+             "shards, 0 to do it in the receiving thread.");
+DEFINE_int32(reply_threads, 2, "Number of threads building and sending the "
+             "replies to pulls, 0 to do it in the receiving thread.");
+DEFINE_int32(replication_chunk, 1 << 16, "Number of parameters in a message "
+             "replicating them to a backup server.");
+DEFINE_string(checkpoint_dir, "", "Directory the server saves checkpoints of "
+              "its parameters in, none are saved if empty.");
+DEFINE_int32(checkpoint_interval, 100, "Number of versions between two "
+             "checkpoints.");
+DEFINE_bool(hogwild, false, "Under ASP, apply the pushes to a shard from "
+            "several threads at once without locks, as Hogwild! does. The "
+            "replies to pulls then read the parameters without locks too, "
+            "and may see a push half applied.");
+DEFINE_string(snapshot, "", "Checkpoint the server starts from, instead of "
+              "the one in the snapshot_dir of the task, if any.");
 
 
 // In Initialize() the server configures itself by sending its IP to the
@@ -83,10 +108,11 @@ bool Server::Initialize() {
   // Initialization of server fields
   local_id_ = msg_recv.recv_id();
   bottom_version_ = 0;
-  consistency_bound_ = config_msg.bound();
+  consistency_.Reset(config_msg.bound(), bottom_version_);
   agent_num_ = config_msg.worker_num();
   server_num_ = config_msg.server_num();
-  LOG(INFO) << "bound = " << consistency_bound_ << ", agent_num_ = " << agent_num_
+  LOG(INFO) << "bound = " << config_msg.bound() << (consistency_.async() ?
+       " (ASP)" : "") << ", agent_num_ = " << agent_num_
        << ", server_num_ = " << server_num_;
 
   // Initialization of sender's id mapping to ip-ports, where the id 0 is
@@ -103,6 +129,10 @@ bool Server::Initialize() {
     LOG(ERROR) << "backup_size_ is wrong";
     return false;
   }
+  backup_versions_.assign(backup_size_, 0);
+  backup_syncing_.assign(backup_size_, false);
+  primary_versions_.assign(backup_size_, 0);
+  replication_lag_ = 0;
 
   // Initialize server ids, and record local parameter range from
   // config_msg.partition.
@@ -132,6 +162,12 @@ bool Server::Initialize() {
     }
   }
   LOG(INFO) << "start_key_ = " << start_key_ << " param_length = " << parameter_length_;
+  sparse_ = config_msg.sparse_capacity() > 0;
+  if (sparse_) {
+    parameter_length_ = config_msg.sparse_capacity();
+    key_index_.Reset(parameter_length_);
+    LOG(INFO) << "Server: sparse, " << parameter_length_ << " slots";
+  }
 
   if (found_local == false) {
     LOG(ERROR) << "Nothing is found to be assigned to the server.";
@@ -150,76 +186,398 @@ bool Server::Initialize() {
     LOG(INFO) << "Add master: " << config_msg.master_id(i);
   }
 
-  // Initialize map from worker ID to version buffer index
+  // Initialize the clocks of the agents
   for (int32 i = 0; i < agent_num_; ++i) {
-    id_to_index_[config_msg.worker_id(i)] = i;
+    consistency_.AddAgent(config_msg.worker_id(i));
   }
 
-  // By default, all parameters are initialized to be zero
-  for (int32 i = 0; i < parameter_length_; ++i)
-    parameters_.push_back(0.0f);
-
-  // Initialize the deque finish_count to be zeros, it's length should be
-  // equal to consistency bound. To maintain finish_count, It's length must
-  // stay unchanged throughout the program.
-  for (int32 i = 0; i < consistency_bound_; ++i)
-    finish_count_.push_back(0);
+  // Split the parameters into a shard per thread.
+  pool_.reset(new ThreadPool(FLAGS_server_threads));
+  reply_pool_.reset(new ThreadPool(FLAGS_reply_threads));
+  checkpoint_pool_.reset(new ThreadPool(1));
+  checkpointing_ = false;
+  optimizer_config_ = config_msg.optimizer();
+  if (!ResetShards()) {
+    LOG(ERROR) << "Unknown optimizer " << optimizer_config_.name();
+    return false;
+  }
+  LOG(INFO) << "Server: " << shards_.size() << " shards, optimizer = "
+            << optimizer_config_.name();
 
-  for (int32 i = 0; i < agent_num_; ++i)
-    version_buffer_.push_back(std::queue<KeyValueList>());
+  // The parameters are mapped from a checkpoint of the shard if there is
+  // one, otherwise they are initialized to be zero.
+  std::string snapshot = FLAGS_snapshot;
+  if (snapshot.empty() && !config_msg.snapshot_dir().empty())
+    snapshot = config_msg.snapshot_dir() + "/" + CheckpointName();
+  if (snapshot.empty() || !RestoreSnapshot(snapshot))
+    parameters_.Assign(parameter_length_, 0.0f);
+  replicated_version_ = bottom_version_;
+  reply_cache_.Reset(static_cast<size_t>(FLAGS_reply_cache_mb) << 20);
   LOG(INFO) << "Server: Server's initialization is done";
   return true;
 }
 
-// ResponseAll is invoked once an update is applied to the parameters.
-// The server use this function to reply to the blocked pull requests.
+// ResponseAll is invoked when the configuration changes. The server use
+// this function to reply to all the blocked pull requests. The replies are
+// only queued for reply_pool_, so the server goes on with the next request
+// right away.
 bool Server::RespondToAll() {
-  while (pull_request_.empty() == false) {
-    std::string reply_str;
-    PullInfo request = pull_request_.front();
-    pull_request_.pop();
-    Message* msg_send = new Message;
-    Message_RequestMessage* reply_msg = new Message_RequestMessage;
-    reply_msg->set_request_type(Message_RequestMessage_RequestType_key_value);
-    int32 len = request.Length();
+  for (auto& pull : waiting_pulls_)
+    SchedulePullReply(std::move(pull.second));
+  waiting_pulls_.clear();
+  return true;
+}
+
+// Reply to the blocked pull requests waiting for bottom_version_ or an
+// earlier version, once an update is applied to the parameters.
+void Server::ReleasePulls() {
+  auto end = waiting_pulls_.upper_bound(bottom_version_);
+  for (auto it = waiting_pulls_.begin(); it != end; ++it)
+    SchedulePullReply(std::move(it->second));
+  waiting_pulls_.erase(waiting_pulls_.begin(), end);
+}
+
+int32 Server::LandedVersion() {
+  std::lock_guard<std::mutex> lock(applying_mutex_);
+  return applying_.empty() ? bottom_version_ : applying_.begin()->first - 1;
+}
+
+// Serialize the RequestMessage replying to request with the parameters of
+// version. indices are the slots of the keys of a sparse server.
+void Server::BuildPullReply(const PullInfo& request,
+                            const std::vector<int32>* indices, int32 version,
+                            std::string* reply) const {
+  Message_RequestMessage reply_msg;
+  reply_msg.set_version(version);
+  int32 len = request.Length();
+  auto index_of = [&](int32 i) {
+    if (indices != NULL) return (*indices)[i];
+    return KeyIndex(request.Key(i));
+  };
+  // Under ASP the pushes are applied while the reply is built, so a
+  // parameter is read under the mutex of its shard, one shard at a time,
+  // unless --hogwild applies them without it.
+  bool lock_shards = consistency_.async() && !FLAGS_hogwild;
+  std::unique_lock<std::mutex> lock;
+  auto hold = [&](int32 index) {
+    std::mutex* mutex = shards_[ShardOf(index)]->mutex();
+    if (lock.mutex() == mutex) return;
+    if (lock.owns_lock()) lock.unlock();
+    lock = std::unique_lock<std::mutex>(*mutex);
+  };
+  // Keys never pushed to a sparse server have their initial value.
+  auto value_of = [&](int32 index) {
+    if (index == SparseKeyIndex::kMissing) return 0.0f;
+    if (lock_shards) hold(index);
+    return parameters_[index];
+  };
+  auto modified_of = [&](int32 index) {
+    if (index == SparseKeyIndex::kMissing) return 0;
+    if (lock_shards) hold(index);
+    return __atomic_load_n(&modified_[index], __ATOMIC_ACQUIRE);
+  };
+
+  if (request.delta()) {
+    // Only the keys changed after the version the agent has.
+    std::vector<int32> keys;
+    std::vector<float32> values;
     for (int32 i = 0; i < len; ++i) {
-      reply_msg->add_keys(request.Key(i));
-      reply_msg->add_values(parameters_[request.Key(i) - start_key_]);
+      int32 index = index_of(i);
+      if (modified_of(index) <= request.since_version()) continue;
+      keys.push_back(request.Key(i));
+      values.push_back(value_of(index));
+    }
+    reply_msg.set_request_type(Message_RequestMessage_RequestType_key_value);
+    reply_msg.set_delta(true);
+    reply_msg.set_start_key(len > 0 ? request.Key(0) : 0);
+    reply_msg.set_length(len);
+    SetKeyValues(keys.data(), values.data(), keys.size(),
+                 request.range() || request.binary(), true, &reply_msg);
+  } else if (request.range()) {
+    reply_msg.set_request_type(Message_RequestMessage_RequestType_range);
+    reply_msg.set_start_key(request.start_key());
+    reply_msg.set_length(len);
+    if (indices == NULL && !lock_shards) {
+      // The indices of a range are contiguous, ServePull checked it.
+      reply_msg.set_payload(reinterpret_cast<const char*>(
+                                parameters_.data() +
+                                KeyIndex(request.start_key())),
+                            len * sizeof(float32));
+    } else {
+      std::vector<float32> values(len);
+      for (int32 i = 0; i < len; ++i) values[i] = value_of(index_of(i));
+      reply_msg.set_payload(reinterpret_cast<const char*>(values.data()),
+                            len * sizeof(float32));
     }
-    msg_send->set_send_id(local_id_);
-    msg_send->set_recv_id(request.get_id());
-    msg_send->set_message_type(Message_MessageType_request);
-    msg_send->set_allocated_request_msg(reply_msg);
-    msg_send->SerializeToString(&reply_str);
-    delete msg_send;
+  } else {
+    std::vector<float32> values(len);
+    for (int32 i = 0; i < len; ++i) values[i] = value_of(index_of(i));
+    reply_msg.set_request_type(Message_RequestMessage_RequestType_key_value);
+    SetKeyValues(request.Keys(), values.data(), len, request.binary(), true,
+                 &reply_msg);
+  }
+  if (lock.owns_lock()) lock.unlock();
+  reply_msg.SerializeToString(reply);
+}
+
+// The reply to a pull is gathered, serialized and sent by reply_pool_, so
+// neither the receiving thread nor the shard updates in pool_ wait for the
+// replies. The parameters are only read there. UpdateParameter waits for
+// the replies before it changes them, but under ASP the pushes are applied
+// while replies are built, which read each shard under its mutex, or with
+// --hogwild, the parameters as they are. A reply is of the landed version:
+// under ASP, the pushes still being applied may or may not be in it, so
+// the agent must not count it as of their versions, or a delta pull would
+// skip the keys they change.
+void Server::SchedulePullReply(PullInfo pull) {
+  std::shared_ptr<const PullInfo> request(new PullInfo(std::move(pull)));
+  // key_index_ is only changed by this thread, so the keys of a sparse
+  // server are looked up here.
+  std::shared_ptr<std::vector<int32>> indices;
+  if (sparse_) {
+    int32 len = request->Length();
+    indices.reset(new std::vector<int32>(len));
+    if (request->range()) {
+      for (int32 i = 0; i < len; ++i) (*indices)[i] = request->Key(i);
+      IndexKeys(indices->data(), len, false, indices->data());
+    } else {
+      IndexKeys(request->Keys(), len, false, indices->data());
+    }
+  }
+  int32 version = LandedVersion();
+  reply_pool_->Schedule([this, request, indices, version] {
+    // A range is cached by its first key and length. Replies in other
+    // formats, or to delta pulls from other versions, are cached apart.
+    int32 range[2] = {request->start_key(), request->Length()};
+    const int32* keys = request->range() ? range : request->Keys();
+    int32 size = request->range() ? 2 : request->Length();
+    int32 format = request->range() ? 2 : request->binary();
+    if (request->delta()) format |= (request->since_version() + 2) << 2;
+    // Agents pulling the same keys in a version get the same reply, which
+    // is gathered and encoded once.
+    std::shared_ptr<const std::string> reply = reply_cache_.Get(
+        keys, size, format, [&](std::string* reply) {
+      BuildPullReply(*request, indices.get(), version, reply);
+    });
+    std::string reply_str;
+    Message msg_send;
+    msg_send.set_send_id(local_id_);
+    msg_send.set_recv_id(request->get_id());
+    msg_send.set_message_type(Message_MessageType_request);
+    msg_send.SerializeToString(&reply_str);
+    AppendRequestMessage(*reply, &reply_str);
 
     // TODO(Song Xu): we'd better try more times before give up replying, and
     // if we decide to give up for one agent, we shoule send a message to warn
     // it about the situation.
-    if (sender_->Send(request.get_id(), reply_str) == -1) {
-      LOG(ERROR) << "Failed to respond to worker " << request.get_id()
-                 << "'s pull request which is blocked before";
+    if (sender_->Send(request->get_id(), std::move(reply_str)) == -1) {
+      LOG(ERROR) << "Failed to respond to worker " << request->get_id()
+                 << "'s pull request.";
     }
+  });
+}
+
+// Split parameters_ into contiguous shards, one per thread of pool_. The
+// sums of the pushes are by index, so they are dropped when the layout
+// changes, and with them the versions not yet applied.
+bool Server::ResetShards() {
+  pool_->Wait();
+  if (!shards_.empty() && shards_.back()->end() == parameter_length_)
+    return true;
+  int32 dropped = consistency_.Restart(bottom_version_);
+  int32 deferred = 0;
+  for (auto& agent : deferred_pushes_) {
+    deferred += agent.second.size();
+    agent.second.clear();
   }
+  if (dropped > 0 || deferred > 0)
+    LOG(ERROR) << "Server drops " << dropped << " versions not yet applied, "
+               << "and " << deferred << " pushes waiting for them";
+
+  // The parameters may have been filled from backups, so all of them count
+  // as changed in this version.
+  modified_.assign(parameter_length_, bottom_version_);
+
+  int32 shards = std::max(pool_->size(), 1);
+  shard_length_ = std::max((parameter_length_ + shards - 1) / shards, 1);
+  shards_.clear();
+  for (int32 s = 0; s < shards; ++s) {
+    int32 begin = std::min(s * shard_length_, parameter_length_);
+    int32 end = std::min(begin + shard_length_, parameter_length_);
+    shards_.emplace_back(new ParameterShard());
+    if (!shards_[s]->Initialize(begin, end, consistency_.versions(),
+                                optimizer_config_))
+      return false;
+  }
+  optimizer_steps_ = 0;
+  changed_.assign(shards, std::vector<int32>());
   return true;
 }
 
+// Fold a push of the version which is version versions above the bottom
+// version into the sums. The keys are turned into indices in parameters_,
+// the pairs are grouped by shard, and each shard adds its group in the
+// thread pool.
+void Server::FoldPush(int32 version, const KeyValueReader& reader) {
+  std::shared_ptr<KeyValueList> update = GroupPush(reader);
+  int32 slot = (bottom_version_ + version) % consistency_.versions();
+  for (int32 s = 0; s < shards_.size(); ++s) {
+    if (update->ShardBegin(s) == update->ShardBegin(s + 1)) continue;
+    pool_->Schedule([this, update, s, slot] {
+      ParameterShard* shard = shards_[s].get();
+      std::lock_guard<std::mutex> lock(*shard->mutex());
+      const int32* indices = update->Keys();
+      const float* values = update->Values();
+      int32 end = update->ShardBegin(s + 1);
+      // Pushes of dense models are mostly runs of consecutive keys, which
+      // are added as vectors.
+      for (int32 j = update->ShardBegin(s), run; j < end; j += run) {
+        for (run = 1;
+             j + run < end && indices[j + run] == indices[j] + run;)
+          ++run;
+        shard->AddRun(slot, indices[j], values + j, run);
+      }
+    });
+  }
+}
+
+// The pairs of a push as indices in parameters_ and values, grouped by
+// shard.
+std::shared_ptr<KeyValueList> Server::GroupPush(
+    const KeyValueReader& reader) {
+  std::vector<int32> indices(reader.size());
+  IndexKeys(reader.keys(), reader.size(), true, indices.data());
+  std::shared_ptr<KeyValueList> update(new KeyValueList());
+  update->Assign(indices.data(), reader.values(), reader.size());
+  // The keys which found the sparse server full are dropped, and so are the
+  // keys outside the shard, e.g. of an agent still on the partition before
+  // a Reconfigure(), which the shards would write out of their arrays.
+  auto outside = [this](int32 index) {
+    return index < 0 || index >= parameter_length_;
+  };
+  if (std::any_of(indices.begin(), indices.end(), outside)) {
+    std::vector<float32> values(reader.values(),
+                                reader.values() + reader.size());
+    int32 size = 0, missing = 0;
+    for (int32 i = 0; i < reader.size(); ++i) {
+      if (outside(indices[i])) {
+        if (sparse_ && indices[i] == SparseKeyIndex::kMissing) ++missing;
+        continue;
+      }
+      indices[size] = indices[i];
+      values[size++] = values[i];
+    }
+    if (missing > 0)
+      LOG(ERROR) << "Server: no slot left for " << missing << " keys";
+    if (reader.size() - size > missing)
+      LOG(ERROR) << "Server: dropped " << reader.size() - size - missing
+                 << " pushed keys outside the shard";
+    update->Assign(indices.data(), values.data(), size);
+  }
+  update->GroupByShard(shards_.size(),
+                       [this](int32 index) { return ShardOf(index); });
+  return update;
+}
+
+// Under ASP, apply a push to the parameters on arrival, as a version of its
+// own, instead of summing it up. Every shard applies its pairs in pool_
+// under its mutex, or with --hogwild without locks, so that pushes to the
+// same shard are applied by several threads at once and may overwrite each
+// other's update of a key, which SGD tolerates for sparse pushes. Nothing
+// waits for the push to be applied. Pulls read the shards under their
+// mutexes too, or with --hogwild as they are, and may see a push half
+// applied.
+void Server::ApplyPush(int32 sender_id,
+                       const Message_RequestMessage& request) {
+  KeyValueReader reader;
+  if (!reader.Parse(request) ||
+      (reader.size() > 0 && reader.values() == NULL)) {
+    LOG(ERROR) << "Got malformed push request from worker " << sender_id;
+    return;
+  }
+  std::shared_ptr<KeyValueList> update = GroupPush(reader);
+  consistency_.Commit(sender_id);
+  consistency_.Advance();
+  int32 version = ++bottom_version_;
+  int32 step = ++optimizer_steps_;
+  float32 scale = 1.0f / agent_num_;
+  bool hogwild = FLAGS_hogwild;
+  std::vector<int32> shards;
+  for (int32 s = 0; s < shards_.size(); ++s)
+    if (update->ShardBegin(s) < update->ShardBegin(s + 1)) shards.push_back(s);
+  if (!shards.empty()) {
+    std::lock_guard<std::mutex> lock(applying_mutex_);
+    applying_[version] = shards.size();
+  }
+  for (int32 s : shards) {
+    pool_->Schedule([this, update, s, scale, step, version, hogwild] {
+      ParameterShard* shard = shards_[s].get();
+      int32 begin = update->ShardBegin(s), end = update->ShardBegin(s + 1);
+      {
+        std::unique_lock<std::mutex> lock(*shard->mutex(), std::defer_lock);
+        if (!hogwild) lock.lock();
+        shard->ApplyValues(update->Keys() + begin, update->Values() + begin,
+                           end - begin, scale, step, parameters_.data(),
+                           modified_.data(), version);
+      }
+      std::lock_guard<std::mutex> lock(applying_mutex_);
+      if (--applying_[version] == 0) applying_.erase(version);
+    });
+  }
+  reply_cache_.Reset(static_cast<size_t>(FLAGS_reply_cache_mb) << 20);
+
+  // The changes are replicated once per round of pushes, and they and the
+  // checkpoints wait for the pushes to be applied.
+  if (backup_size_ > 0) {
+    changed_[0].insert(changed_[0].end(), update->Keys(),
+                       update->Keys() + update->Length());
+  }
+  bool replicate = backup_size_ > 0 && bottom_version_ % agent_num_ == 0;
+  bool checkpoint = !FLAGS_checkpoint_dir.empty() &&
+                    FLAGS_checkpoint_interval > 0 &&
+                    bottom_version_ % FLAGS_checkpoint_interval == 0;
+  if (replicate || checkpoint) pool_->Wait();
+  if (replicate) ReplicateChanges();
+  if (checkpoint) SaveCheckpoint();
+}
+
+void Server::IndexKeys(const int32* keys, int32 size, bool insert,
+                       int32* indices) {
+  if (!sparse_) {
+    for (int32 i = 0; i < size; ++i) indices[i] = KeyIndex(keys[i]);
+  } else if (insert) {
+    key_index_.FindOrInsert(keys, size, indices);
+  } else {
+    key_index_.Find(keys, size, indices);
+  }
+}
+
 // After the server receives update of one version from all agents,
 // UpdateParameter is called to merge the updates to current parameter.
-// Simple implementation -- average.
+// The pushes are already summed up, so every shard applies their average
+// with its optimizer, in a thread of its own. Only the keys pushed in this
+// version are visited unless most of the shard is pushed.
 void Server::UpdateParameter() {
-  std::vector<float> update(parameter_length_, 0.0f);
-  for (int32 i = 0; i < agent_num_; ++i) {
-    KeyValueList update_i = version_buffer_[i].front();
-    version_buffer_[i].pop();
-    int32 len = update_i.Length();
-    for (int32 j = 0; j < len; ++j)
-      update[update_i.Key(j) - start_key_] += update_i.Value(j);
-  }
-  for (int32 i = 0; i < parameter_length_; ++i) {
-    parameters_[i] += update[i] / agent_num_;
+  // Pushes still being summed up and replies still reading the parameters
+  // go first.
+  reply_pool_->Wait();
+  pool_->Wait();
+  int32 slot = bottom_version_ % consistency_.versions();
+  float32 scale = 1.0f / agent_num_;
+  int32 step = ++optimizer_steps_;
+  int32 version = bottom_version_ + 1;
+  for (size_t s = 0; s < shards_.size(); ++s) {
+    ParameterShard* shard = shards_[s].get();
+    std::vector<int32>* changed = backup_size_ > 0 ? &changed_[s] : NULL;
+    pool_->Schedule([this, shard, slot, scale, step, version, changed] {
+      shard->Apply(slot, parameters_.data(), scale, step, modified_.data(),
+                   version, changed);
+    });
   }
+  pool_->Wait();
+  consistency_.Advance();
   bottom_version_++;
+  reply_cache_.Reset(static_cast<size_t>(FLAGS_reply_cache_mb) << 20);
 }
 
 // In Start(), the server repeatedly receive message from agents, and
@@ -253,14 +611,16 @@ void Server::Start() {
     }
 
     if (msg_recv.message_type() == Message_MessageType_request) {
-      Message_RequestMessage request = msg_recv.request_msg();
+      const Message_RequestMessage& request = msg_recv.request_msg();
       if (request.request_type()
         == Message_RequestMessage_RequestType_key_value) {
         // Push request:
         LOG(INFO) << "ServePush";
         ServePush(sender_id, request);
       } else if (request.request_type()
-        == Message_RequestMessage_RequestType_key) {
+        == Message_RequestMessage_RequestType_key ||
+        request.request_type()
+        == Message_RequestMessage_RequestType_range) {
         // Pull request:
         LOG(INFO) << "ServePull";
         ServePull(sender_id, request);
@@ -277,33 +637,32 @@ void Server::Start() {
   }
 }
 
-// Serve push request. Since consistency will be handled by ServePull(),
-// we can always insert the push update in the queue.
-// If a round of version update is finished after the push, UpdateParameter()
-// and RespondToAll() will be called to return the new version of parameters
-// to the blocked workers.
+// Serve push request. The push is summed up into the version given by the
+// clock of the worker, unless the worker is bound versions ahead, when it
+// waits for the versions before it to be applied.
+// If a round of version update is finished after the push,
+// ApplyCompleteVersions() will return the new version of parameters to the
+// blocked workers.
 void Server::ServePush(int32 sender_id,
   const Message_RequestMessage &request) {
-  if (agent_ids_.find(sender_id) == agent_ids_.end()) {
+  if (!consistency_.HasAgent(sender_id)) {
     LOG(ERROR) << "Got push request from worker " << sender_id
                << ", which is unknown by the server.";
     return;
   }
-  // Chenbin: There may be a bug here, can bound errors be called here?
-  if (version_buffer_[id_to_index_[sender_id]].size() >= consistency_bound_) {
-    LOG(ERROR) << "Version_buffer_" << id_to_index_[sender_id]
-               << " overfilled";
-  } else {
-    LOG(INFO) << "Push to version_buffer_[" << id_to_index_[sender_id]
-              << "/" << version_buffer_.size() << "]";
-    finish_count_[version_buffer_[id_to_index_[sender_id]].size()]++;
-    KeyValueList worker_update;
-    for (int32 i = 0; i < request.keys_size(); ++i) {
-      worker_update.AddPair(request.keys(i), request.values(i));
-      LOG(INFO) << "AddPair {" << request.keys(i) << ", " << request.values(i) << "}";
-    }
-    version_buffer_[id_to_index_[sender_id]].push(worker_update);
+  if (consistency_.async()) {
+    ApplyPush(sender_id, request);
+    return;
+  }
+  std::deque<Message_RequestMessage>& deferred = deferred_pushes_[sender_id];
+  if (!deferred.empty() ||
+      consistency_.PushOffset(sender_id) == ConsistencyManager::kWait) {
+    LOG(INFO) << "Push of worker " << sender_id << " waits for version "
+              << consistency_.WaitVersion(sender_id);
+    deferred.push_back(request);
+    return;
   }
+  if (!CommitPush(sender_id, request)) return;
   // Acknowledgement from server
   // Chenbin: I annotate these block of code because the agent does not handle the ack message.
 //  std::string send_str;
@@ -321,39 +680,87 @@ void Server::ServePush(int32 sender_id,
 //               << "'s push request.";
 //  }
 
-  // Update of the bottom version is done
-  // We can call UpdateParameter() when finish_count_[0] is larger than
-  // m*agent_num_/n, as an expedience between speed and consistency.
-  if (finish_count_[0] == agent_num_) {
-    finish_count_.pop_front();
-    finish_count_.push_back(0);
-    LOG(INFO) << "UpdateParameter & RespondToAll & RequestBackup";
+  ApplyCompleteVersions();
+}
+
+// Sum up a push of sender_id into the version of its clock, and advance the
+// clock. Return false if the push is malformed.
+bool Server::CommitPush(int32 sender_id,
+                        const Message_RequestMessage& request) {
+  KeyValueReader reader;
+  if (!reader.Parse(request) ||
+      (reader.size() > 0 && reader.values() == NULL)) {
+    LOG(ERROR) << "Got malformed push request from worker " << sender_id;
+    return false;
+  }
+  FoldPush(consistency_.PushOffset(sender_id), reader);
+  consistency_.Commit(sender_id);
+  return true;
+}
+
+// Apply the versions every worker has pushed, release the pulls waiting for
+// them, and sum up the pushes which waited for them, which may complete
+// further versions.
+void Server::ApplyCompleteVersions() {
+  while (consistency_.Complete()) {
+    LOG(INFO) << "UpdateParameter & ReleasePulls & ReplicateChanges";
     UpdateParameter();
-    RespondToAll();
-    RequestBackup();
+    ReleasePulls();
+    ReplicateChanges();
+    if (!FLAGS_checkpoint_dir.empty() && FLAGS_checkpoint_interval > 0 &&
+        bottom_version_ % FLAGS_checkpoint_interval == 0)
+      SaveCheckpoint();
+    for (auto& agent : deferred_pushes_) {
+      std::deque<Message_RequestMessage>& deferred = agent.second;
+      while (!deferred.empty() && consistency_.PushOffset(agent.first) !=
+                                      ConsistencyManager::kWait) {
+        CommitPush(agent.first, deferred.front());
+        deferred.pop_front();
+      }
+    }
   }
 }
 
-// ServePull() will handle version consistency by checking the number of
-// updates that the worker has already committed but is not yet processed by
-// the server. If the number of updates in version_buffer is too large, the
-// pull request will be blocked.
+// ServePull() will handle version consistency by checking the clock of the
+// worker, the number of versions it has pushed. If the worker is bound
+// versions ahead of the server, the pull request will be blocked until the
+// server catches up.
 void Server::ServePull(int32 sender_id,
    const Message_RequestMessage &request) {
-  if (id_to_index_.find(sender_id) == id_to_index_.end()) {
+  if (!consistency_.HasAgent(sender_id)) {
     LOG(ERROR) << "Got pull request from worker " << sender_id
       << ", which is unknown to the server.";
     return;
   }
+  PullInfo pull;
+  pull.set_id(sender_id);
+  if (request.request_type() == Message_RequestMessage_RequestType_range) {
+    // The range must lie in the key range, and in the shard of a dense
+    // server, where its indices are then contiguous.
+    int32 start = request.start_key(), length = request.length();
+    if (start < 0 || length < 0 || start >= key_range_ ||
+        length > key_range_ - start ||
+        (!sparse_ && KeyIndex(start) + length > parameter_length_)) {
+      LOG(ERROR) << "Got pull request from worker " << sender_id
+                 << " for keys out of range";
+      return;
+    }
+    pull.SetRange(start, length);
+  } else {
+    KeyValueReader reader;
+    if (!reader.Parse(request)) {
+      LOG(ERROR) << "Got malformed pull request from worker " << sender_id;
+      return;
+    }
+    pull.set_binary(reader.binary());
+    pull.AssignKeys(reader.keys(), reader.size());
+  }
+  if (request.delta()) pull.SetDelta(request.since_version());
   // Blocked when enough update is pushed but not yet processed
   // A block message will be sent to the sender agent
-  if (version_buffer_[id_to_index_[sender_id]].size()
-    >= consistency_bound_) {
-    PullInfo blocked_request;
-    blocked_request.set_id(sender_id);
-    for (int32 i = 0; i < request.keys_size(); ++i)
-      blocked_request.AddKey(request.keys(i));
-    pull_request_.push(blocked_request);
+  if (consistency_.PullWaits(sender_id)) {
+    waiting_pulls_.emplace(consistency_.WaitVersion(sender_id),
+                           std::move(pull));
 
     // Chenbin: I annotate these block of code because the agent does not handle the error message
 //    std::string send_str;
@@ -371,36 +778,15 @@ void Server::ServePull(int32 sender_id,
 //        << "'s pull request.";
 //    }
   } else {
-    std::string reply_str;
-    Message* msg_send = new Message;
-    Message_RequestMessage* reply_msg = new Message_RequestMessage;
-    reply_msg->set_request_type(
-      Message_RequestMessage_RequestType_key_value);
-    for (int32 i = 0; i < request.keys_size(); ++i) {
-      reply_msg->add_keys(request.keys(i));
-      int32 index = request.keys(i) - start_key_;
-      if (index < 0) {
-        index += key_range_;
-      }
-      reply_msg->add_values(parameters_[index]);
-    }
-    msg_send->set_message_type(Message_MessageType_request);
-    msg_send->set_allocated_request_msg(reply_msg);
-    msg_send->set_send_id(local_id_);
-    msg_send->set_recv_id(sender_id);
-    msg_send->SerializeToString(&reply_str);
-    delete msg_send;
-    if (sender_->Send(sender_id, reply_str) == -1) {
-      LOG(ERROR) << "Failed to respond to worker " << sender_id
-        << "'s pull request.";
-    }
+    SchedulePullReply(std::move(pull));
   }
 }
 
 // Heartbeat function receives liveness check from master and reply as a
 // heartbeat. Server won't terminate itself or change to a new master if
 // current master is not heard for a long time. Instead, it waits for
-// another master to send live check to it.
+// another master to send live check to it. The heartbeat reports the
+// replication lag of the backups the server keeps.
 void* Server::HeartBeat(void* arg) {
   Server* server = reinterpret_cast<Server*>(arg);
   Message send_msg, recv_msg;
@@ -420,13 +806,16 @@ void* Server::HeartBeat(void* arg) {
     LOG(INFO) << "Server: Receive heartbeat message from master with id "
               << recv_msg.send_id();
     // Config the send_msg
+    int32 lag = server->replication_lag_;
     send_msg.set_recv_id(recv_msg.send_id());
+    hb_msg->set_replication_lag(lag);
     send_msg.SerializeToString(&send_str);
 
     if (server->sender_->Send(0, send_str) == -1) {
       LOG(ERROR) << "Cannot send a heartbeat to master";
     }
-    LOG(INFO) << "Server: Send heartbeat message to master";
+    LOG(INFO) << "Server: Send heartbeat message to master, replication lag "
+              << lag;
   }
 }
 
@@ -453,8 +842,10 @@ void Server::Reconfigure(const Message_ConfigMessage &config_msg) {
   int agent_num;  // should be assigned to the attributes
   bool found_local;
 
-  // Respond to all agents to clear the pull_request_
+  // Respond to all agents to clear the waiting_pulls_
   RespondToAll();
+  reply_pool_->Wait();
+  pool_->Wait();
 
   agent_num = config_msg.worker_num();
   server_num_ = config_msg.server_num();
@@ -472,8 +863,10 @@ void Server::Reconfigure(const Message_ConfigMessage &config_msg) {
     if (server_i_id == local_id_) {
       local_index_ = i;
       start_key_ = config_msg.partition(i);
-      parameter_length_ = (config_msg.partition((i + 1) % server_num_)
-                           - start_key_ + key_range_) % key_range_;
+      // The slots of a sparse server do not depend on its key range.
+      if (!sparse_)
+        parameter_length_ = (config_msg.partition((i + 1) % server_num_)
+                             - start_key_ + key_range_) % key_range_;
       found_local = true;
     }
   }
@@ -511,10 +904,13 @@ void Server::Reconfigure(const Message_ConfigMessage &config_msg) {
       }
     }
     if (!found) {
-      for (int32 i = 0; i < version_buffer_[id_to_index_[id]].size(); ++i)
-        finish_count_[i]--;
-      while (version_buffer_[id_to_index_[id]].size()) version_buffer_[id_to_index_[id]].pop();
-      id_to_index_.erase(id);
+      // The pushes are already summed up, so they stay in the sums, but the
+      // versions no longer wait for the agent.
+      consistency_.RemoveAgent(id);
+      if (!deferred_pushes_[id].empty())
+        LOG(ERROR) << "Server drops " << deferred_pushes_[id].size()
+                   << " pushes of worker " << id;
+      deferred_pushes_.erase(id);
     }
   }
 
@@ -525,85 +921,295 @@ void Server::Reconfigure(const Message_ConfigMessage &config_msg) {
     agent_ids_.insert(config_msg.worker_id(i));
   }
 
-  // refresh map from worker ID to version buffer index
-  LOG(INFO) << "Reconfigure the id_to_index_";
-  for (int32 i = 0; i < agent_num_; ++i) {
-    if (id_to_index_.find(config_msg.worker_id(i)) == id_to_index_.end()) {
-      id_to_index_[config_msg.worker_id(i)] = version_buffer_.size();
-      version_buffer_.push_back(std::queue<KeyValueList>());
-    }
-  }
+  // New workers start at the version of the server.
+  LOG(INFO) << "Reconfigure the clocks of the workers";
+  for (int32 i = 0; i < config_msg.worker_id_size(); ++i)
+    consistency_.AddAgent(config_msg.worker_id(i));
 
   // Extend parameters if necessary
-  ExtendParameter();
+  if (!sparse_) ExtendParameter();
+  ResetShards();
+  reply_cache_.Reset(static_cast<size_t>(FLAGS_reply_cache_mb) << 20);
 
   agent_num_ = agent_num;
+  // The servers this one backs up may have changed.
+  RequestBackup();
+  // The versions may only have waited for the removed workers.
+  ApplyCompleteVersions();
+}
+
+// Push the parameters changed since the last replication, by the last
+// update or under ASP by the last round of pushes, to the servers backing
+// this one up, so replication costs as much as the update instead of the
+// whole shard. A version changing no parameter still sends a chunk, which
+// tells the backups they are up to date.
+void Server::ReplicateChanges() {
+  if (backup_size_ == 0) return;
+  std::vector<int32> successors;
+  for (int32 i = 1; i <= backup_size_; i++)
+    successors.push_back(server_ids_[(local_index_ + i) % server_num_]);
+  // The shards are in order, so the indices are increasing.
+  std::vector<int32> indices;
+  for (auto& changed : changed_) {
+    indices.insert(indices.end(), changed.begin(), changed.end());
+    changed.clear();
+  }
+  if (consistency_.async()) {
+    // The pushes since the last replication, in the order they came.
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  }
+  int32 size = indices.size();
+  int32 chunk_size = std::max(FLAGS_replication_chunk, 1);
+  std::vector<float32> values(std::min(chunk_size, size));
+  int32 offset = 0;
+  do {
+    int32 length = std::min(chunk_size, size - offset);
+    for (int32 i = 0; i < length; ++i)
+      values[i] = parameters_[indices[offset + i]];
+    Message_RequestMessage chunk;
+    chunk.set_request_type(Message_RequestMessage_RequestType_key_value);
+    SetKeyValues(indices.data() + offset, values.data(), length, true, true,
+                 &chunk);
+    chunk.set_since_version(replicated_version_);
+    offset += length;
+    SendBackupChunk(successors, &chunk, offset < size);
+  } while (offset < size);
+  replicated_version_ = bottom_version_;
+}
+
+// Send chunk of the parameters of bottom_version_ to server_ids. It is
+// serialized once for all of them.
+void Server::SendBackupChunk(const std::vector<int32>& server_ids,
+                             Message_RequestMessage* chunk, bool more) {
+  chunk->set_version(bottom_version_);
+  chunk->set_shard_length(parameter_length_);
+  chunk->set_more(more);
+  std::string chunk_str;
+  chunk->SerializeToString(&chunk_str);
+  for (int32 server_id : server_ids) {
+    Message msg_send;
+    msg_send.set_message_type(Message_MessageType_request);
+    msg_send.set_send_id(local_id_);
+    msg_send.set_recv_id(server_id);
+    std::string send_str;
+    msg_send.SerializeToString(&send_str);
+    AppendRequestMessage(chunk_str, &send_str);
+    if (sender_->Send(server_id, std::move(send_str)) == -1) {
+      LOG(ERROR) << "Failed to send parameters to backup server " << server_id;
+    }
+  }
 }
 
 // Send request message to other servers, requesting for there parameters
 void Server::RequestBackup() {
-  LOG(INFO) << "RequestBackup";
+  for (int32 i = 0; i < backup_size_; i++) RequestBackup(i);
+}
 
+void Server::RequestBackup(int32 backup) {
+  int32 target = (local_index_ - 1 - backup + server_num_) % server_num_;
+  int32 server_id = server_ids_[target];
   std::string str;
-  Message* msg = new Message;
-  Message_RequestMessage request;
-  int32 server_id;
-
-  for (int32 i = 1; i <= backup_size_; i++) {
-    int32 target = (local_index_ - i + server_num_) % server_num_;
-    server_id = server_ids_[target];
-    msg->set_send_id(local_id_);
-    msg->set_recv_id(server_id);
-    msg->set_message_type(Message_MessageType_request);
-    msg->SerializeToString(&str);
-    if (sender_->Send(server_id, str) == -1) {
-      LOG(ERROR) << "Failed to send request to server: " << server_id;
-    }
-    LOG(INFO) << "Server: Send request to server " << server_id;
+  Message msg;
+  msg.set_send_id(local_id_);
+  msg.set_recv_id(server_id);
+  msg.set_message_type(Message_MessageType_request);
+  msg.SerializeToString(&str);
+  if (sender_->Send(server_id, std::move(str)) == -1) {
+    LOG(ERROR) << "Failed to send request to server: " << server_id;
+    return;
   }
-};
+  backup_syncing_[backup] = true;
+  LOG(INFO) << "Server: Send request to server " << server_id;
+}
 
-// Backup
+// Apply a chunk of the parameters of a server this one backs up. The
+// changes of a version apply on top of the backup of the version before,
+// so when a version is missed, the changes are ignored until a full copy,
+// which is then requested, has arrived.
 void Server::Backup(const Message& msg) {
-  Message_RequestMessage request;
-  int32 server_id, server_index;
-
-  server_id = msg.send_id();
-  server_index = (local_index_ - 1 - servers_[server_id] + server_num_) % server_num_;
-  request = msg.request_msg();
-  LOG(INFO) << "Server: Get respond from server " << server_id;
-  // Reset the backup_parameters_'s size if necessary
-  if (backup_parameters_[server_index].size() != request.values_size()) {
-    backup_parameters_[server_index] = std::vector<float32>(request.values_size());
+  int32 server_id = msg.send_id();
+  int32 backup = (local_index_ - 1 - servers_[server_id] + server_num_) %
+                 server_num_;
+  if (backup >= backup_size_) {
+    LOG(ERROR) << "Got parameters of server " << server_id
+               << ", which is not backed up by the server.";
+    return;
   }
-  for (int32 i = 0; i < request.values_size(); i++) {
-    backup_parameters_[server_index][i] = request.values(i);
-    LOG(INFO) << "Backup index: " << server_index << " value: " << request.values(i);
+  const Message_RequestMessage& chunk = msg.request_msg();
+  std::vector<float32>& parameters = backup_parameters_[backup];
+  int32& version = backup_versions_[backup];
+  // A backup waiting for a full copy falls behind as the server goes on.
+  primary_versions_[backup] = std::max(primary_versions_[backup],
+                                       chunk.version());
+  replication_lag_ = ReplicationLag();
+  if (chunk.request_type() == Message_RequestMessage_RequestType_range) {
+    // A chunk of a full copy.
+    if (parameters.size() != chunk.shard_length())
+      parameters.assign(chunk.shard_length(), 0.0f);
+    int32 start = chunk.start_key(), length = chunk.length();
+    if (start < 0 || length < 0 || length > chunk.shard_length() - start ||
+        chunk.payload().size() != length * sizeof(float32)) {
+      LOG(ERROR) << "Got malformed parameters of server " << server_id;
+      return;
+    }
+    memcpy(parameters.data() + start, chunk.payload().data(),
+           chunk.payload().size());
+    if (chunk.more()) return;
+    backup_syncing_[backup] = false;
+  } else {
+    // A chunk of the changes after since_version.
+    if (backup_syncing_[backup] || chunk.version() <= version) return;
+    if (chunk.since_version() > version ||
+        parameters.size() != chunk.shard_length()) {
+      LOG(ERROR) << "Backup of server " << server_id << " misses versions "
+                 << version + 1 << " to " << chunk.since_version();
+      RequestBackup(backup);
+      return;
+    }
+    KeyValueReader reader;
+    if (!reader.Parse(chunk) ||
+        (reader.size() > 0 && reader.values() == NULL)) {
+      LOG(ERROR) << "Got malformed parameters of server " << server_id;
+      return;
+    }
+    for (int32 i = 0; i < reader.size(); ++i) {
+      int32 index = reader.keys()[i];
+      if (index >= 0 && index < parameters.size())
+        parameters[index] = reader.values()[i];
+    }
+    if (chunk.more()) return;
   }
+  version = chunk.version();
+  replication_lag_ = ReplicationLag();
+  LOG(INFO) << "Server: backup of server " << server_id << " at version "
+            << version << ", " << primary_versions_[backup] - version
+            << " versions behind";
 }
 
-// Respond backup request from other servers
+// Respond backup request from other servers with a full copy of the
+// parameters, in range chunks. Under ASP the copy waits for the pushes
+// being applied, so it is of bottom_version_.
 void Server::RespondBackup(int32 server_id) {
-    std::string reply_str;
-    Message* msg_send = new Message;
-    Message_RequestMessage* reply_msg = new Message_RequestMessage;
-    reply_msg->set_request_type(
-      Message_RequestMessage_RequestType_key_value);
-    for (int32 i = 0; i < parameter_length_; ++i) {
-      reply_msg->add_keys(start_key_ + i);
-      reply_msg->add_values(parameters_[i]);
-    }
-    // TODO: Add bottom_version_ to the message
-    msg_send->set_message_type(Message_MessageType_request);
-    msg_send->set_allocated_request_msg(reply_msg);
-    msg_send->set_send_id(local_id_);
-    msg_send->set_recv_id(server_id);
-    msg_send->SerializeToString(&reply_str);
-    delete msg_send;
-    if (sender_->Send(server_id, reply_str) == -1) {
-      LOG(ERROR) << "Failed to respond to server " << server_id
-                 << "'s pull request.";
+  pool_->Wait();
+  int32 chunk_size = std::max(FLAGS_replication_chunk, 1);
+  int32 offset = 0;
+  do {
+    int32 length = std::min(chunk_size, parameter_length_ - offset);
+    Message_RequestMessage chunk;
+    chunk.set_request_type(Message_RequestMessage_RequestType_range);
+    chunk.set_start_key(offset);
+    chunk.set_length(length);
+    chunk.set_payload(reinterpret_cast<const char*>(parameters_.data() +
+                                                    offset),
+                      length * sizeof(float32));
+    offset += length;
+    SendBackupChunk({server_id}, &chunk, offset < parameter_length_);
+  } while (offset < parameter_length_);
+}
+
+int32 Server::ReplicationLag() const {
+  int32 lag = 0;
+  for (int32 i = 0; i < backup_size_; ++i)
+    lag = std::max(lag, primary_versions_[i] - backup_versions_[i]);
+  return lag;
+}
+
+// Copy the parameters of bottom_version_ and the state of the optimizers
+// into a snapshot, and write it to the checkpoint file in checkpoint_pool_,
+// so the server only stalls for the copy. The snapshot is taken between
+// updates, so it is consistent. If the last checkpoint is still being
+// written, this one is skipped.
+void Server::SaveCheckpoint() {
+  if (checkpointing_) {
+    LOG(ERROR) << "Server: skips the checkpoint of version " << bottom_version_
+               << ", the last one is still being written";
+    return;
+  }
+  std::shared_ptr<Checkpoint> checkpoint(new Checkpoint());
+  checkpoint->version = bottom_version_;
+  checkpoint->start_key = start_key_;
+  checkpoint->key_range = key_range_;
+  checkpoint->optimizer = shards_[0]->optimizer()->name();
+  checkpoint->values.assign(parameters_.begin(), parameters_.end());
+  // The state of the shards is put together in the order of the shards, so
+  // it does not depend on the number of them.
+  int32 arrays = shards_[0]->optimizer()->StateArrays().size();
+  checkpoint->state.resize(arrays);
+  for (auto& array : checkpoint->state) array.reserve(parameter_length_);
+  for (auto& shard : shards_) {
+    std::vector<std::vector<float32>*> state =
+        shard->optimizer()->StateArrays();
+    for (int32 i = 0; i < arrays; ++i)
+      checkpoint->state[i].insert(checkpoint->state[i].end(),
+                                  state[i]->begin(), state[i]->end());
+  }
+  checkpoint->steps = optimizer_steps_;
+  if (sparse_) {
+    checkpoint->keys.resize(key_index_.size());
+    key_index_.Keys(checkpoint->keys.data());
+  }
+
+  std::string path = FLAGS_checkpoint_dir + "/" + CheckpointName();
+  checkpointing_ = true;
+  checkpoint_pool_->Schedule([this, checkpoint, path] {
+    if (checkpoint->Write(path)) {
+      LOG(INFO) << "Server: saved the checkpoint of version "
+                << checkpoint->version << " to " << path;
+    } else {
+      LOG(ERROR) << "Failed to save the checkpoint to " << path;
     }
+    checkpointing_ = false;
+  });
+}
+
+std::string Server::CheckpointName() const {
+  return "shard_" + std::to_string(start_key_) + ".ckpt";
+}
+
+// Map the checkpoint at path as the parameters, and restore the version,
+// the state of the optimizers and the keys of a sparse server from it, so
+// the server serves at once however large the shard is. Return false if
+// path is not a checkpoint of the shard.
+bool Server::RestoreSnapshot(const std::string& path) {
+  std::unique_ptr<MappedCheckpoint> checkpoint(new MappedCheckpoint());
+  if (!checkpoint->Open(path)) {
+    LOG(ERROR) << "Failed to map the snapshot " << path;
+    return false;
+  }
+  const CheckpointHeader& header = checkpoint->header();
+  Optimizer* optimizer = shards_[0]->optimizer();
+  if (header.length != parameter_length_ || header.key_range != key_range_ ||
+      (!sparse_ && header.start_key != start_key_) ||
+      optimizer->name() != header.optimizer ||
+      header.state_arrays != optimizer->StateArrays().size() ||
+      header.steps > header.version) {
+    LOG(ERROR) << "The snapshot " << path << " is not of the server's shard";
+    return false;
+  }
+  // The arrays are cut at the bounds of the shards, and the steps are
+  // counted for the whole server, so a snapshot restores into any number of
+  // shards.
+  for (auto& shard : shards_) {
+    std::vector<std::vector<float32>*> state =
+        shard->optimizer()->StateArrays();
+    for (int32 i = 0; i < header.state_arrays; ++i)
+      state[i]->assign(checkpoint->state(i) + shard->begin(),
+                       checkpoint->state(i) + shard->end());
+  }
+  optimizer_steps_ = header.steps;
+  if (sparse_) {
+    key_index_.Reset(parameter_length_);
+    for (int64 i = 0; i < header.keys; ++i)
+      key_index_.FindOrInsert(checkpoint->keys()[i]);
+  }
+  bottom_version_ = header.version;
+  consistency_.Restart(bottom_version_);
+  modified_.assign(parameter_length_, bottom_version_);
+  parameters_.Map(std::move(checkpoint));
+  LOG(INFO) << "Server: starts from the snapshot " << path << " of version "
+            << bottom_version_;
+  return true;
 }
 
 // Extend current parameters to more parameters
@@ -613,8 +1219,7 @@ void Server::ExtendParameter() {
     LOG(INFO) << v;
   for (int i = 0; i < backup_size_; i++) {
     if (parameters_.size() == parameter_length_) break;
-    parameters_.insert(parameters_.begin(), backup_parameters_[i].begin(),
-                       backup_parameters_[i].end());
+    parameters_.Prepend(backup_parameters_[i]);
   }
   LOG(INFO) << "Server: After extension: " << "start_key_ = " << start_key_ << " values: = ";
   for (auto v : parameters_)
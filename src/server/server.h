@@ -3,17 +3,28 @@
 #ifndef SRC_SERVER_SERVER_H_
 #define SRC_SERVER_SERVER_H_
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <map>
-#include <queue>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "src/communication/zmq_communicator.h"
+#include "src/message/key_value_codec.h"
 #include "src/message/message.pb.h"
+#include "src/server/checkpoint.h"
+#include "src/server/consistency_manager.h"
 #include "src/server/key_value_list.h"
+#include "src/server/parameter_shard.h"
+#include "src/server/parameter_store.h"
 #include "src/server/pull_info.h"
+#include "src/server/reply_cache.h"
+#include "src/server/sparse_key_index.h"
 #include "src/util/common.h"
+#include "src/util/thread_pool.h"
 
 namespace rpscc {
 
@@ -25,11 +36,11 @@ DECLARE_string(net_interface);
 // The server then updates the parameters it is in charge of, or return the
 // parameters requested by the agent (if it's not blocked for consistency).
 // The consistency of parameter versions is handled by servers. For every
-// agent, it signals all servers after finishing its work. A server maintains
-// finish_count of every parameter version. When a count equals to the number
-// of agents, the iteration of the current parameter version is considered
-// to be finished. A server can use these counts to meet the demands of BSP
-// or SSP consistency model.
+// agent, it signals all servers after finishing its work. A server keeps
+// the clock of every agent, the number of versions it has pushed. When the
+// clock of the slowest agent passes a version, the iteration of the version
+// is considered to be finished. A server can use these clocks to meet the
+// demands of BSP, SSP or ASP consistency model, see ConsistencyManager.
 class Server {
  public:
   Server() { }
@@ -47,7 +58,6 @@ class Server {
   int32 local_id_;
   int32 start_key_;
   int32 parameter_length_;
-  int32 consistency_bound_;
   int32 bottom_version_;
   int32 agent_num_;
   int32 server_num_;
@@ -58,27 +68,119 @@ class Server {
   std::vector<int32> server_ids_;
   std::unordered_map<int32, int32> servers_;
   std::unordered_set<int32> agent_ids_;
-  std::vector<float> parameters_;
+  ParameterStore parameters_;
+  // The version in which each of parameters_ was last changed.
+  std::vector<int32> modified_;
   std::vector<std::vector<float>> backup_parameters_;
-  std::vector<std::queue<KeyValueList>> version_buffer_;
-  std::deque<int32> finish_count_;
-  std::queue<PullInfo> pull_request_;
-  std::map<int32, int32> id_to_index_;
+  // The version of each of backup_parameters_, and whether a full copy of
+  // it is requested and not yet received.
+  std::vector<int32> backup_versions_;
+  std::vector<bool> backup_syncing_;
+  // The latest version each server backed up has sent chunks of.
+  std::vector<int32> primary_versions_;
+  // ReplicationLag() as of the last chunk, which the heartbeats report.
+  std::atomic<int32> replication_lag_;
+  // Indices in parameters_ changed since the last replication, by shard,
+  // which are replicated to the servers backing this one up. Under ASP
+  // they are all kept in the first.
+  std::vector<std::vector<int32>> changed_;
+  // The version the backups have been sent the changes up to.
+  int32 replicated_version_;
+  // The clocks of the agents, which decide when versions are applied.
+  ConsistencyManager consistency_;
+  // Pushes of each agent which wait for their version to have a slot.
+  std::map<int32, std::deque<Message_RequestMessage>> deferred_pushes_;
+  // parameters_ split into shard_length_ long shards, one per thread of
+  // pool_.
+  std::vector<std::unique_ptr<ParameterShard>> shards_;
+  int32 shard_length_;
+  Message_OptimizerConfig optimizer_config_;
+  // Under ASP, the number of shards each version is still being applied
+  // to in pool_, guarded by applying_mutex_.
+  std::map<int32, int32> applying_;
+  std::mutex applying_mutex_;
+  // Number of updates the optimizers of the shards have made since they
+  // were reset, the step of the last one. It is counted for the whole
+  // server, so the shards agree on it whichever of them an update touches.
+  int32 optimizer_steps_;
+  std::unique_ptr<ThreadPool> pool_;
+  // Threads building and sending the replies to pulls.
+  std::unique_ptr<ThreadPool> reply_pool_;
+  // The thread writing checkpoints, and whether it is writing one.
+  std::unique_ptr<ThreadPool> checkpoint_pool_;
+  std::atomic<bool> checkpointing_;
+  // Blocked pulls, by the version they wait for.
+  std::multimap<int32, PullInfo> waiting_pulls_;
+  // Replies to the pulls of bottom_version_.
+  ReplyCache reply_cache_;
+  // A sparse task keeps the parameters of the keys the server has seen, in
+  // the slots of parameters_ given by key_index_, instead of its whole key
+  // range.
+  bool sparse_;
+  SparseKeyIndex key_index_;
 
   // Thread for heartbeat
   pthread_t heartbeat_;
 
+  // Index in shards_ of the shard holding index of parameters_.
+  int32 ShardOf(int32 index) const {
+    return std::min(index / shard_length_,
+                    static_cast<int32>(shards_.size()) - 1);
+  }
+
+  // Index of key in parameters_. The shard of the last server wraps around
+  // the key range, so its keys below start_key_ come after the others.
+  int32 KeyIndex(int32 key) const {
+    int32 index = key - start_key_;
+    return index < 0 ? index + key_range_ : index;
+  }
+
+  // Indices in parameters_ of size keys. A sparse server gives new keys
+  // slots if insert is true, and the index of the keys it has not seen, or
+  // has no slot left for, is SparseKeyIndex::kMissing.
+  void IndexKeys(const int32* keys, int32 size, bool insert, int32* indices);
+
   bool RespondToAll();
+  void ReleasePulls();
+  // The last version which is applied along with all the versions before
+  // it. Under ASP it may be behind bottom_version_.
+  int32 LandedVersion();
+  void BuildPullReply(const PullInfo& request,
+                      const std::vector<int32>* indices, int32 version,
+                      std::string* reply) const;
+  void SchedulePullReply(PullInfo request);
+  bool ResetShards();
+  void FoldPush(int32 version, const KeyValueReader& reader);
+  std::shared_ptr<KeyValueList> GroupPush(const KeyValueReader& reader);
+  void ApplyPush(int32 sender_id, const Message_RequestMessage& request);
   void UpdateParameter();
+  bool CommitPush(int32 sender_id, const Message_RequestMessage& request);
+  void ApplyCompleteVersions();
   void ServePull(int32 sender_id, const Message_RequestMessage &request);
   void ServePush(int32 sender_id, const Message_RequestMessage &request);
   static void* HeartBeat(void* arg);
   void Reconfigure(const Message_ConfigMessage &config);
-  // UNKNOWN: Use a new thread or not?
+  // The next backup_size_ servers back this one up. After an update, only
+  // the parameters it changed are pushed to them, and a full copy is sent
+  // to a server which asks for it, both in chunks of --replication_chunk
+  // parameters.
+  void ReplicateChanges();
+  void SendBackupChunk(const std::vector<int32>& server_ids,
+                       Message_RequestMessage* chunk, bool more);
+  // Ask the servers this one backs up, or the backup-th of them, for a
+  // full copy of their parameters.
   void RequestBackup();
+  void RequestBackup(int32 backup);
   void Backup(const Message& msg);
   void RespondBackup(int32 server_id);
+  // Number of versions the most outdated backup is behind the latest
+  // version its server has sent.
+  int32 ReplicationLag() const;
   void ExtendParameter();
+  void SaveCheckpoint();
+  // Name of the checkpoint file of the shard.
+  std::string CheckpointName() const;
+  bool RestoreSnapshot(const std::string& path);
 };
 
 }  // namespace rpscc
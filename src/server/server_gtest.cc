@@ -9,6 +9,7 @@
 #include "src/server/key_value_list.h"
 #include "src/server/pull_info.h"
 #include "src/communication/zmq_communicator.h"
+#include "src/message/key_value_codec.h"
 #include "src/message/message.pb.h"
 
 using namespace std;
@@ -79,6 +80,9 @@ void SimulOuter() {
     config_msg->add_worker_id(1);
     config_msg->add_master_id(0);
     config_msg->set_bound(1);
+    // Server 2 backs up server 4, the server before it on the ring, and is
+    // backed up by server 3.
+    config_msg->set_backup_size(1);
 
     msg_send.set_message_type(Message_MessageType_config);
     msg_send.set_recv_id(2);
@@ -169,6 +173,7 @@ void SimulOuter() {
     config_msg->add_worker_id(1);
     config_msg->add_master_id(0);
     config_msg->set_bound(1);
+    config_msg->set_backup_size(1);
 
     msg_send.set_message_type(Message_MessageType_config);
     msg_send.set_recv_id(2);
@@ -179,19 +184,78 @@ void SimulOuter() {
     LOG(INFO) << "Master: Master send Reconfig string to server";
     sender.Send(2, config_str);
   }
-  sleep(20);
+  sleep(2);
+
+  // Server 2 now holds keys 5 to 9, the backup of server 4 prepended to
+  // its parameters, and then its keys 0 to 2.
+  {
+    request_msg = new Message_RequestMessage();
+    request_msg->set_request_type(Message_RequestMessage_RequestType_key);
+    for (int32 key : {5, 6, 7, 8, 9, 0, 1, 2}) request_msg->add_keys(key);
+    msg_send.set_message_type(Message_MessageType_request);
+    msg_send.set_recv_id(2);
+    msg_send.set_send_id(1);
+    msg_send.set_allocated_request_msg(request_msg);
+    msg_send.SerializeToString(&request_str);
+    LOG(INFO) << "Agent: Agent send pull request string to server";
+    sender.Send(2, request_str);
+
+    string reply_str;
+    agent_receiver.Receive(&reply_str);
+    msg_recv.ParseFromString(reply_str);
+    KeyValueReader reader;
+    ASSERT_TRUE(reader.Parse(msg_recv.request_msg()));
+    ASSERT_EQ(8, reader.size());
+    ASSERT_TRUE(reader.values() != NULL);
+    for (int32 i = 0; i < 5; ++i)
+      EXPECT_FLOAT_EQ(50.0f + i, reader.values()[i]) << "key " << 5 + i;
+    for (int32 i = 0; i < 3; ++i)
+      EXPECT_FLOAT_EQ(0.1f * (i + 1), reader.values()[5 + i]) << "key " << i;
+  }
+  sleep(2);
+}
+
+// Send server 2 a full copy of the parameters of a helper server, in two
+// range chunks, as RespondBackup() does.
+void SendFullCopy(ZmqCommunicator* sender, int server_id,
+                  const vector<float>& parameters, int version) {
+  int32 length = parameters.size();
+  for (int32 offset : {0, length / 2}) {
+    int32 size = offset == 0 ? length / 2 : length - length / 2;
+    Message_RequestMessage* chunk = new Message_RequestMessage;
+    chunk->set_request_type(Message_RequestMessage_RequestType_range);
+    chunk->set_start_key(offset);
+    chunk->set_length(size);
+    chunk->set_payload(reinterpret_cast<const char*>(parameters.data() +
+                                                     offset),
+                       size * sizeof(float));
+    chunk->set_version(version);
+    chunk->set_shard_length(length);
+    chunk->set_more(offset == 0);
+    Message msg_send;
+    msg_send.set_message_type(Message_MessageType_request);
+    msg_send.set_allocated_request_msg(chunk);
+    msg_send.set_send_id(server_id);
+    msg_send.set_recv_id(2);
+    string msg_str;
+    msg_send.SerializeToString(&msg_str);
+    if (sender->Send(2, msg_str) == -1) {
+      LOG(ERROR) << "Failed to send parameters to server " << 2;
+    }
+  }
 }
 
-void SimulServer(int server_id, int16 listen_port, int start_key, int param_len) {
-  LOG(INFO) << "Helper Server " << server_id << ": " << server_id << " " << listen_port << " " << start_key
-            << param_len;
+// This function will simulate a server next to server 2 on the ring. It
+// sends server 2 a full copy of its parameters when asked to, or at first
+// if unasked is set, and checks the changes server 2 replicates to it.
+void SimulServer(int server_id, int16 listen_port, int start_key,
+                 int param_len, bool unasked) {
+  LOG(INFO) << "Helper Server " << server_id << ": " << server_id << " "
+            << listen_port << " " << start_key << param_len;
   ZmqCommunicator sender;
   ZmqCommunicator receiver;
 
-  Message msg_send;
   Message msg_recv;
-  Message_RequestMessage* msg_reply;
-
   string msg_str;
 
   sender.Initialize(64/* ring_size */, true, 1024/* listen_port */);
@@ -202,50 +266,43 @@ void SimulServer(int server_id, int16 listen_port, int start_key, int param_len)
   for (int i = 0; i < param_len; i++)
     parameters.push_back(i + start_key * 10);
 
+  if (unasked) {
+    // Server 2 is configured by now, and backs this server up.
+    sleep(6);
+    LOG(INFO) << "Helper Server " << server_id << ": Send full copy";
+    SendFullCopy(&sender, server_id, parameters, 1);
+  }
+
   while (true) {
-    LOG(INFO) << "Helper Server " << server_id << ": Wait for server's backup_request";
+    LOG(INFO) << "Helper Server " << server_id << ": Wait for server 2";
     receiver.Receive(&msg_str);
-    LOG(INFO) << "Helper Server " << server_id << ": Get server's request";
     msg_recv.ParseFromString(msg_str);
     EXPECT_EQ(msg_recv.recv_id(), server_id);
     EXPECT_EQ(msg_recv.send_id(), 2);
-    msg_reply = new Message_RequestMessage;
-    msg_reply->set_request_type(Message_RequestMessage_RequestType_key_value);
-    for (int32 i = 0; i < param_len; ++i) {
-      msg_reply->add_keys(start_key + i);
-      msg_reply->add_values(parameters[i]);
+    if (!msg_recv.has_request_msg()) {
+      LOG(INFO) << "Helper Server " << server_id << ": Get backup request";
+      SendFullCopy(&sender, server_id, parameters, 1);
+      continue;
     }
-    msg_send.set_message_type(Message_MessageType_request);
-    msg_send.set_allocated_request_msg(msg_reply);
-    msg_send.set_send_id(server_id);
-    msg_send.set_recv_id(2);
-    msg_send.SerializeToString(&msg_str);
-    if (sender.Send(2, msg_str) == -1) {
-      LOG(ERROR) << "Failed to respond to server " << 2
-                 << "'s pull request.";
-    }
-    LOG(INFO) << "Helper Server " << server_id << ": Sent respond to server";
-
-    sleep(1);
-    LOG(INFO) << "Helper Server " << server_id << ": Try to send backup_request to server";
-    msg_send.clear_request_msg();
-    msg_send.SerializeToString(&msg_str);
-    if (sender.Send(2, msg_str) == -1) {
-      LOG(ERROR) << "Failed to request to server" << 2;
-    }
-    LOG(INFO) << "Helper Server " << server_id << ": Sent backup request to server 2";
-    LOG(INFO) << "Helper Server " << server_id << ": Wait for server's backup_respond";
-    receiver.Receive(&msg_str);
-    LOG(INFO) << "Helper Server " << server_id << ": Get server's request";
-    msg_recv.ParseFromString(msg_str);
-    EXPECT_EQ(2, msg_recv.send_id());
-    EXPECT_EQ(server_id, msg_recv.recv_id());
-    for (int32 i = 0; i < msg_recv.request_msg().values_size(); i++) {
-      LOG(INFO) << "Helper Server " << server_id <<  ": Get params " << msg_recv.request_msg().keys(i) << " "
-                << msg_recv.request_msg().values(i);
+    // The changes of the version server 2 applied after the push of keys
+    // 0, 1 and 2, which this server backs up.
+    const Message_RequestMessage& chunk = msg_recv.request_msg();
+    EXPECT_EQ(Message_RequestMessage_RequestType_key_value,
+              chunk.request_type());
+    EXPECT_EQ(1, chunk.version());
+    EXPECT_EQ(0, chunk.since_version());
+    EXPECT_EQ(3, chunk.shard_length());
+    EXPECT_FALSE(chunk.more());
+    KeyValueReader reader;
+    ASSERT_TRUE(reader.Parse(chunk));
+    ASSERT_EQ(3, reader.size());
+    for (int32 i = 0; i < reader.size(); i++) {
+      LOG(INFO) << "Helper Server " << server_id << ": Get params "
+                << reader.keys()[i] << " " << reader.values()[i];
+      EXPECT_EQ(i, reader.keys()[i]);
+      EXPECT_FLOAT_EQ(0.1f * (i + 1), reader.values()[i]);
     }
   }
-
 }
 
 TEST(ServerTest, TestServer) {
@@ -260,13 +317,13 @@ TEST(ServerTest, TestServer) {
   int server3_id, server4_id, server2_id;
   server3_id = fork();
   if (server3_id == 0) {
-    SimulServer(3, 5006, 3, 2);
+    SimulServer(3, 5006, 3, 2, false);
     return;
   }
 
   server4_id = fork();
   if (server4_id == 0) {
-    SimulServer(4, 5007, 5, 5);
+    SimulServer(4, 5007, 5, 5, true);
     return;
   }
 
@@ -287,6 +344,131 @@ TEST(ServerTest, TestServer) {
   kill(server4_id, SIGKILL);
 }
 
+// This function will simulate the master and an agent of an ASP task, which
+// pushes to the server while it pulls the keys changed since the version of
+// its last reply. The pushes are applied as the replies are built, so a
+// reply may miss some of them, but the next delta pull must bring them.
+void SimulAsyncOuter() {
+  const int32 kKeys = 8;
+  const int32 kRounds = 50;
+  ZmqCommunicator sender;
+  ZmqCommunicator master_receiver, agent_receiver;
+
+  Message msg_send;
+  Message msg_recv;
+  string msg_str;
+
+  sender.Initialize(64/* ring_size */, true, 1024/* listen_port */);
+  master_receiver.Initialize(64, false, 5010);
+  agent_receiver.Initialize(64, false, 5565);
+
+  LOG(INFO) << "Master: Wait for server's registration";
+  master_receiver.Receive(&msg_str);
+  msg_recv.ParseFromString(msg_str);
+  EXPECT_EQ(msg_recv.register_msg().port(), 5510);
+  sender.AddIdAddr(2, "127.0.0.1:5510");
+
+  Message_ConfigMessage* config_msg = new Message_ConfigMessage();
+  config_msg->set_worker_num(1);
+  config_msg->set_server_num(1);
+  config_msg->set_key_range(kKeys);
+  config_msg->add_node_ip_port("127.0.0.1:5010");  // Master 0
+  config_msg->add_node_ip_port("127.0.0.1:5565");  // Agent  1
+  config_msg->add_node_ip_port("127.0.0.1:5510");  // Server 2
+  config_msg->add_partition(0);
+  config_msg->add_server_id(2);
+  config_msg->add_worker_id(1);
+  config_msg->add_master_id(0);
+  config_msg->set_bound(0);  // ASP
+  msg_send.set_message_type(Message_MessageType_config);
+  msg_send.set_recv_id(2);
+  msg_send.set_send_id(0);
+  msg_send.set_allocated_config_msg(config_msg);
+  msg_send.SerializeToString(&msg_str);
+  LOG(INFO) << "Master: Master send config string to server";
+  sender.Send(2, msg_str);
+  sleep(1);
+
+  // The agent keeps the parameters it has pulled, and the version of the
+  // last reply, after which the keys it has not seen changed.
+  vector<float> view(kKeys, 0.0f), expected(kKeys, 0.0f);
+  int32 since_version = -1;
+  auto pull = [&](bool delta) {
+    Message_RequestMessage* request_msg = new Message_RequestMessage();
+    request_msg->set_request_type(Message_RequestMessage_RequestType_key);
+    for (int32 key = 0; key < kKeys; ++key) request_msg->add_keys(key);
+    request_msg->set_delta(delta);
+    request_msg->set_since_version(since_version);
+    Message request;
+    request.set_message_type(Message_MessageType_request);
+    request.set_recv_id(2);
+    request.set_send_id(1);
+    request.set_allocated_request_msg(request_msg);
+    string request_str, reply_str;
+    request.SerializeToString(&request_str);
+    sender.Send(2, request_str);
+
+    agent_receiver.Receive(&reply_str);
+    Message reply;
+    reply.ParseFromString(reply_str);
+    const Message_RequestMessage& reply_msg = reply.request_msg();
+    EXPECT_EQ(delta, reply_msg.delta());
+    EXPECT_GE(reply_msg.version(), since_version);
+    KeyValueReader reader;
+    EXPECT_TRUE(reader.Parse(reply_msg));
+    vector<float> values(kKeys, 0.0f);
+    for (int32 i = 0; i < reader.size(); ++i)
+      (delta ? view : values)[reader.keys()[i]] = reader.values()[i];
+    since_version = reply_msg.version();
+    return values;
+  };
+
+  for (int32 round = 0; round < kRounds; ++round) {
+    Message_RequestMessage* request_msg = new Message_RequestMessage();
+    request_msg->set_request_type(
+        Message_RequestMessage_RequestType_key_value);
+    // The two keys differ, round and 3 * round + 1 are of different parity.
+    for (int32 key : {round % kKeys, (round * 3 + 1) % kKeys}) {
+      request_msg->add_keys(key);
+      request_msg->add_values(1.0f);
+      expected[key] += 1.0f;
+    }
+    msg_send.Clear();
+    msg_send.set_message_type(Message_MessageType_request);
+    msg_send.set_recv_id(2);
+    msg_send.set_send_id(1);
+    msg_send.set_allocated_request_msg(request_msg);
+    msg_send.SerializeToString(&msg_str);
+    sender.Send(2, msg_str);
+    if (round % 3 == 0) pull(true);
+  }
+  sleep(1);
+
+  // Once the pushes are applied, a delta pull brings the view to the sums
+  // of the pushes, which a full pull also gives.
+  pull(true);
+  EXPECT_EQ(kRounds, since_version);
+  EXPECT_EQ(expected, view);
+  EXPECT_EQ(expected, pull(false));
+}
+
+TEST(ServerTest, TestAsyncDeltaPull) {
+  Server server;
+  int server_id = fork();
+  if (server_id == 0) {
+    sleep(1);
+    FLAGS_master_ip_port = "127.0.0.1:5010";
+    FLAGS_server_port = 5510;
+    FLAGS_net_interface = "lo";
+    server.Initialize();
+    server.Start();
+  }
+
+  SimulAsyncOuter();
+
+  kill(server_id, SIGKILL);
+}
+
 //int main(int argc, char **argv) {
 //  gflags::ParseCommandLineFlags(&argc, &argv, true);
 //  ::testing::InitGoogleTest(&argc, argv);
@@ -23,6 +23,16 @@ class TestServer : public Server {
   void TestServePush(int32, const Message_RequestMessage &);
   bool TestInitialize(int32);
   void TestStart(std::queue<std::string>*);
+
+ private:
+  // The server sums up the pushes as they arrive and keeps the clocks of
+  // the agents, the test keeps the pushes as lists and counts them by
+  // version.
+  std::vector<std::queue<KeyValueList>> version_buffer_;
+  std::deque<int32> finish_count_;
+  std::queue<PullInfo> pull_request_;
+  std::map<int32, int32> id_to_index_;
+  int32 consistency_bound_;
 };
 
 bool TestServer::TestInitialize(int32 bound) {
@@ -40,8 +50,7 @@ bool TestServer::TestInitialize(int32 bound) {
     id_to_index_[i] = i;
 
   // By default, all parameters are initialized to be zero
-  for (int32 i = 0; i < parameter_length_; ++i)
-    parameters_.push_back(0.0f);
+  parameters_.Assign(parameter_length_, 0.0f);
 
   // Initialize the deque finish_count to be zeros, it's length should be
   // equal to consistency bound. To maintain finish_count, It's length must
@@ -0,0 +1,49 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/sparse_key_index.h"
+
+namespace rpscc {
+
+const int32 SparseKeyIndex::kMissing;
+
+void SparseKeyIndex::Reset(int32 capacity) {
+  size_ = 0;
+  capacity_ = capacity;
+  buckets_.assign(kMinBuckets, Bucket{0, kMissing});
+  mask_ = kMinBuckets - 1;
+}
+
+int32 SparseKeyIndex::FindOrInsert(int64 key) {
+  uint64 b = Hash(key) & mask_;
+  for (; buckets_[b].slot != kMissing; b = (b + 1) & mask_) {
+    if (buckets_[b].key == key) return buckets_[b].slot;
+  }
+  if (size_ >= capacity_) return kMissing;
+  if (2 * static_cast<uint64>(size_ + 1) > buckets_.size()) {
+    Grow();
+    for (b = Hash(key) & mask_; buckets_[b].slot != kMissing;)
+      b = (b + 1) & mask_;
+  }
+  buckets_[b].key = key;
+  buckets_[b].slot = size_;
+  return size_++;
+}
+
+void SparseKeyIndex::Keys(int64* keys) const {
+  for (const Bucket& bucket : buckets_)
+    if (bucket.slot != kMissing) keys[bucket.slot] = bucket.key;
+}
+
+void SparseKeyIndex::Grow() {
+  std::vector<Bucket> old(2 * buckets_.size(), Bucket{0, kMissing});
+  old.swap(buckets_);
+  mask_ = buckets_.size() - 1;
+  for (const Bucket& bucket : old) {
+    if (bucket.slot == kMissing) continue;
+    uint64 b = Hash(bucket.key) & mask_;
+    while (buckets_[b].slot != kMissing) b = (b + 1) & mask_;
+    buckets_[b] = bucket;
+  }
+}
+
+}  // namespace rpscc
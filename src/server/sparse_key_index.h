@@ -0,0 +1,101 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#ifndef SRC_SERVER_SPARSE_KEY_INDEX_H_
+#define SRC_SERVER_SPARSE_KEY_INDEX_H_
+
+#include <vector>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// SparseKeyIndex gives the 64 bit keys of a sparse model dense slots
+// 0, 1, 2, ... in the order they are first seen, so a server stores the
+// parameters of the keys it has seen instead of its whole key range.
+// It is an open addressing hash table with linear probing. A bucket holds a
+// key and its slot in 16 bytes, so a probe mostly stays in one cache line,
+// and the table doubles when it is half full. Slots are never freed, and at
+// most capacity of them are given out.
+// The batched lookups prefetch the buckets of the keys a few positions
+// ahead, which hides most of the cache misses of a large table.
+class SparseKeyIndex {
+ public:
+  // The slot of keys not in the index, and of new keys when it is full.
+  static const int32 kMissing = -1;
+
+  SparseKeyIndex() { Reset(0); }
+
+  // Drop all keys, and give out at most capacity slots from now on.
+  void Reset(int32 capacity);
+
+  int32 size() const { return size_; }
+  int32 capacity() const { return capacity_; }
+
+  // Return the slot of key, or kMissing.
+  int32 Find(int64 key) const {
+    for (uint64 b = Hash(key) & mask_; ; b = (b + 1) & mask_) {
+      const Bucket& bucket = buckets_[b];
+      if (bucket.slot == kMissing || bucket.key == key) return bucket.slot;
+    }
+  }
+
+  // Return the slot of key, giving it the next slot if it is new.
+  int32 FindOrInsert(int64 key);
+
+  // Set keys[slot] to the key of every slot in [0, size()). Inserting the
+  // keys in this order into an empty index gives them the same slots.
+  void Keys(int64* keys) const;
+
+  // The slots of size keys, Key is int32 or int64.
+  template <typename Key>
+  void Find(const Key* keys, int32 size, int32* slots) const {
+    for (int32 i = 0; i < size; ++i) {
+      if (i + kPrefetchDistance < size) Prefetch(keys[i + kPrefetchDistance]);
+      slots[i] = Find(keys[i]);
+    }
+  }
+
+  template <typename Key>
+  void FindOrInsert(const Key* keys, int32 size, int32* slots) {
+    for (int32 i = 0; i < size; ++i) {
+      if (i + kPrefetchDistance < size) Prefetch(keys[i + kPrefetchDistance]);
+      slots[i] = FindOrInsert(keys[i]);
+    }
+  }
+
+ private:
+  struct Bucket {
+    int64 key;
+    int32 slot;
+  };
+
+  static const int32 kPrefetchDistance = 8;
+  static const int32 kMinBuckets = 16;
+
+  // The finalizer of MurmurHash3, which spreads keys differing in the low
+  // bits, like consecutive feature IDs, over the table.
+  static uint64 Hash(int64 key) {
+    uint64 h = static_cast<uint64>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  void Prefetch(int64 key) const {
+    __builtin_prefetch(&buckets_[Hash(key) & mask_]);
+  }
+
+  void Grow();
+
+  int32 size_;
+  int32 capacity_;
+  uint64 mask_;
+  std::vector<Bucket> buckets_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_SPARSE_KEY_INDEX_H_
@@ -0,0 +1,95 @@
+// Copyright (c) 2019 The RPSCC Authors. All rights reserved.
+//
+// Benchmark for the sparse key index of the server against the dense
+// parameter vector. A push of n random keys out of the keys the server has
+// seen is looked up, and the parameters of the keys are read, once through
+// SparseKeyIndex with and without prefetching, and once as offsets into a
+// dense vector, as a dense server does. The memory of the parameters of the
+// seen keys is reported for both, for a key space of 2^40 features.
+//
+// Usage: ./sparse_key_index_benchmark --distinct=1000000 --batch=100000
+
+#include <stdio.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "src/server/sparse_key_index.h"
+
+DEFINE_int32(distinct, 1000000, "Number of distinct keys seen by the server.");
+DEFINE_int32(batch, 100000, "Number of keys of a push.");
+DEFINE_int32(rounds, 20, "Number of pushes looked up.");
+
+using namespace rpscc;
+
+namespace {
+
+const int64 kKeySpace = int64(1) << 40;
+
+template <typename Function>
+double Measure(const Function& function) {
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  for (int32 round = 0; round < FLAGS_rounds; round++) function(round);
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count() / FLAGS_rounds;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::mt19937_64 random(17);
+  std::vector<int64> seen(FLAGS_distinct);
+  for (auto& key : seen) key = random() % kKeySpace;
+
+  SparseKeyIndex index;
+  index.Reset(FLAGS_distinct);
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  std::vector<int32> slots(FLAGS_distinct);
+  index.FindOrInsert(seen.data(), FLAGS_distinct, slots.data());
+  double insert = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+  std::vector<float32> parameters(index.size(), 1.0f);
+
+  // The dense server would index a vector of the whole key space, the
+  // offsets are folded into distinct slots to stay in memory.
+  std::vector<float32> dense(FLAGS_distinct, 1.0f);
+  std::vector<std::vector<int64>> pushes(FLAGS_rounds);
+  for (auto& push : pushes) {
+    push.resize(FLAGS_batch);
+    for (auto& key : push) key = seen[random() % FLAGS_distinct];
+  }
+
+  std::vector<int32> push_slots(FLAGS_batch);
+  float32 sum = 0;
+  double batched = Measure([&](int32 round) {
+    index.Find(pushes[round].data(), FLAGS_batch, push_slots.data());
+    for (int32 i = 0; i < FLAGS_batch; i++) sum += parameters[push_slots[i]];
+  });
+  double single = Measure([&](int32 round) {
+    for (int32 i = 0; i < FLAGS_batch; i++)
+      sum += parameters[index.Find(pushes[round][i])];
+  });
+  double offsets = Measure([&](int32 round) {
+    for (int32 i = 0; i < FLAGS_batch; i++)
+      sum += dense[pushes[round][i] % FLAGS_distinct];
+  });
+
+  printf("distinct = %d, insert %.1f ns/key\n", FLAGS_distinct,
+         insert / FLAGS_distinct * 1e9);
+  printf("batch = %d\n", FLAGS_batch);
+  printf("  sparse batched  %7.1f ns/key\n", batched / FLAGS_batch * 1e9);
+  printf("  sparse one key  %7.1f ns/key\n", single / FLAGS_batch * 1e9);
+  printf("  dense offset    %7.1f ns/key\n", offsets / FLAGS_batch * 1e9);
+  printf("memory: sparse about %.1f MB, dense %.1f GB\n",
+         (parameters.size() * sizeof(float32) + 16.0 * 2 * FLAGS_distinct) /
+             (1 << 20),
+         kKeySpace * sizeof(float32) / double(1 << 30));
+  // sum keeps the reads from being optimized out.
+  printf("checksum %g\n", sum);
+  return 0;
+}
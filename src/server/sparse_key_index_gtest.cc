@@ -0,0 +1,72 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/server/sparse_key_index.h"
+
+using namespace rpscc;
+
+TEST(SparseKeyIndex, SlotsInOrderOfFirstSight) {
+  SparseKeyIndex index;
+  index.Reset(10);
+  EXPECT_EQ(SparseKeyIndex::kMissing, index.Find(7));
+  EXPECT_EQ(0, index.FindOrInsert(7));
+  EXPECT_EQ(1, index.FindOrInsert(-3));
+  EXPECT_EQ(2, index.FindOrInsert(int64(1) << 60));
+  EXPECT_EQ(0, index.FindOrInsert(7));
+  EXPECT_EQ(1, index.Find(-3));
+  EXPECT_EQ(2, index.Find(int64(1) << 60));
+  EXPECT_EQ(SparseKeyIndex::kMissing, index.Find(8));
+  EXPECT_EQ(3, index.size());
+}
+
+TEST(SparseKeyIndex, Full) {
+  SparseKeyIndex index;
+  index.Reset(2);
+  EXPECT_EQ(0, index.FindOrInsert(1));
+  EXPECT_EQ(1, index.FindOrInsert(2));
+  EXPECT_EQ(SparseKeyIndex::kMissing, index.FindOrInsert(3));
+  // Keys already in a full index keep their slots.
+  EXPECT_EQ(1, index.FindOrInsert(2));
+  EXPECT_EQ(2, index.size());
+}
+
+TEST(SparseKeyIndex, Keys) {
+  SparseKeyIndex index;
+  index.Reset(100);
+  for (int64 key : {9, -4, 1000, 3}) index.FindOrInsert(key);
+  std::vector<int64> keys(index.size());
+  index.Keys(keys.data());
+  EXPECT_EQ(std::vector<int64>({9, -4, 1000, 3}), keys);
+}
+
+// The table grows many times, and the batched lookups agree with a map.
+TEST(SparseKeyIndex, Batched) {
+  const int32 size = 100000;
+  std::mt19937_64 random(5);
+  std::vector<int64> keys(size);
+  for (auto& key : keys) key = random() % (size / 2) * 0x9e3779b97f4a7c15ULL;
+  SparseKeyIndex index;
+  index.Reset(size);
+  std::vector<int32> slots(size);
+  index.FindOrInsert(keys.data(), size, slots.data());
+
+  std::unordered_map<int64, int32> expected;
+  for (int32 i = 0; i < size; ++i) {
+    auto it = expected.emplace(keys[i], expected.size()).first;
+    ASSERT_EQ(it->second, slots[i]) << "at " << i;
+  }
+  EXPECT_EQ(expected.size(), index.size());
+
+  std::vector<int32> narrow_keys(size);
+  for (int32 i = 0; i < size; ++i) narrow_keys[i] = i;
+  index.Find(narrow_keys.data(), size, slots.data());
+  for (int32 i = 0; i < size; ++i) {
+    auto it = expected.find(i);
+    EXPECT_EQ(it == expected.end() ? SparseKeyIndex::kMissing : it->second,
+              slots[i]);
+  }
+}
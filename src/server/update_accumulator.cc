@@ -0,0 +1,104 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/update_accumulator.h"
+
+#include <algorithm>
+
+#include "src/server/optimizer.h"
+#include "src/server/update_kernels.h"
+
+namespace rpscc {
+
+void UpdateAccumulator::Resize(int32 length) {
+  sums_.assign(length, 0.0f);
+  marks_.assign((length + 63) / 64, 0);
+  touched_.clear();
+  dense_ = false;
+  dense_threshold_ = length / kDenseFraction;
+}
+
+void UpdateAccumulator::AddRun(int32 index, const float32* values,
+                               int32 size) {
+  if (size < 8) {
+    for (int32 i = 0; i < size; ++i) Add(index + i, values[i]);
+    return;
+  }
+  int32 i = 0;
+  for (; i < size && !dense_; ++i) {
+    int32 k = index + i;
+    uint64 bit = 1ull << (k & 63);
+    if ((marks_[k >> 6] & bit) == 0) {
+      marks_[k >> 6] |= bit;
+      touched_.push_back(k);
+      if (touched_.size() > dense_threshold_) dense_ = true;
+    }
+  }
+  MarkRun(index + i, index + size);
+  Kernels().accumulate(sums_.data() + index, values, size);
+}
+
+void UpdateAccumulator::MarkRun(int32 begin, int32 end) {
+  while (begin < end) {
+    int32 bits = std::min(64 - (begin & 63), end - begin);
+    uint64 mask = bits == 64 ? ~0ull : ((1ull << bits) - 1) << (begin & 63);
+    marks_[begin >> 6] |= mask;
+    begin += bits;
+  }
+}
+
+void UpdateAccumulator::MarkTouched(int32* versions, int32 version) const {
+  if (dense_) {
+    std::fill(versions, versions + sums_.size(), version);
+  } else {
+    for (int32 index : touched_) versions[index] = version;
+  }
+}
+
+void UpdateAccumulator::AppendTouched(int32 offset,
+                                      std::vector<int32>* indices) const {
+  size_t begin = indices->size();
+  if (dense_) {
+    indices->resize(begin + sums_.size());
+    for (size_t i = 0; i < sums_.size(); ++i)
+      (*indices)[begin + i] = offset + i;
+  } else {
+    for (int32 index : touched_) indices->push_back(offset + index);
+    std::sort(indices->begin() + begin, indices->end());
+  }
+}
+
+void UpdateAccumulator::ApplyTo(float32* parameters, float32 scale) {
+  if (dense_) {
+    Kernels().apply(parameters, sums_.data(), scale, sums_.size());
+  } else {
+    for (int32 index : touched_) {
+      parameters[index] += sums_[index] * scale;
+      sums_[index] = 0.0f;
+    }
+  }
+  ClearTouched();
+}
+
+void UpdateAccumulator::ApplyTo(float32* parameters, float32 scale,
+                                Optimizer* optimizer, int32 step) {
+  if (dense_) {
+    optimizer->ApplyDense(parameters, sums_.data(), marks_.data(), scale,
+                          sums_.size(), step);
+  } else {
+    optimizer->Apply(parameters, sums_.data(), scale, touched_.data(),
+                     touched_.size(), step);
+  }
+  ClearTouched();
+}
+
+void UpdateAccumulator::ClearTouched() {
+  if (dense_) {
+    std::fill(marks_.begin(), marks_.end(), 0);
+  } else {
+    for (int32 index : touched_) marks_[index >> 6] = 0;
+  }
+  touched_.clear();
+  dense_ = false;
+}
+
+}  // namespace rpscc
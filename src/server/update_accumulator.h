@@ -0,0 +1,86 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+#ifndef SRC_SERVER_UPDATE_ACCUMULATOR_H_
+#define SRC_SERVER_UPDATE_ACCUMULATOR_H_
+
+#include <vector>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+class Optimizer;
+
+// UpdateAccumulator sums up the updates of one parameter version before they
+// are applied to the parameters. The sums are kept in an array as long as
+// the shard, which stays zero between versions, so nothing is allocated or
+// cleared per version. The indices touched in a version are recorded with a
+// bitmap, and applying the sums only visits them, so a sparse version costs
+// time in the number of touched keys instead of the length of the shard.
+// Once more than 1 / kDenseFraction of the shard is touched, the list of
+// touched indices stops growing and the whole shard is swept instead, which
+// is faster for dense updates. The bitmap is still kept, so that an
+// optimizer with state steps only the keys pushed in the version. Runs of
+// consecutive indices and the dense sweep are done with the SIMD kernels of
+// update_kernels.h.
+class UpdateAccumulator {
+ public:
+  UpdateAccumulator() : dense_(false), dense_threshold_(0) {}
+
+  // Set the length of the shard, dropping the sums.
+  void Resize(int32 length);
+  int32 Length() const { return sums_.size(); }
+
+  // Add value to the sum of index, which must be in [0, Length()).
+  void Add(int32 index, float32 value) {
+    uint64 bit = 1ull << (index & 63);
+    uint64& word = marks_[index >> 6];
+    if ((word & bit) == 0) {
+      word |= bit;
+      if (!dense_) {
+        touched_.push_back(index);
+        if (touched_.size() > dense_threshold_) dense_ = true;
+      }
+    }
+    sums_[index] += value;
+  }
+
+  // Add values[i] to the sum of index + i for i in [0, size).
+  void AddRun(int32 index, const float32* values, int32 size);
+
+  // Number of touched indices, or Length() once the sweep is dense.
+  int32 Touched() const { return dense_ ? Length() : touched_.size(); }
+
+  // Set versions[index] to version for the touched indices, or for all of
+  // them once the sweep is dense.
+  void MarkTouched(int32* versions, int32 version) const;
+
+  // Append offset + index to indices for the touched indices in increasing
+  // order, or for all of them once the sweep is dense.
+  void AppendTouched(int32 offset, std::vector<int32>* indices) const;
+
+  // Add the sums times scale to parameters, and clear them for the next
+  // version.
+  void ApplyTo(float32* parameters, float32 scale);
+  // Apply the sums times scale to parameters as gradients with optimizer,
+  // as its step-th update, and clear them for the next version.
+  void ApplyTo(float32* parameters, float32 scale, Optimizer* optimizer,
+               int32 step);
+
+ private:
+  static const int32 kDenseFraction = 8;
+
+  // Set the bits of [begin, end) in marks_, a word at a time.
+  void MarkRun(int32 begin, int32 end);
+  // Clear the record of touched indices after the sums are applied.
+  void ClearTouched();
+
+  std::vector<float32> sums_;
+  std::vector<uint64> marks_;
+  std::vector<int32> touched_;
+  bool dense_;
+  size_t dense_threshold_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_UPDATE_ACCUMULATOR_H_
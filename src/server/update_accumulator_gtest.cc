@@ -0,0 +1,158 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/server/optimizer.h"
+#include "src/server/update_accumulator.h"
+#include "src/server/update_kernels.h"
+
+using namespace rpscc;
+
+TEST(UpdateAccumulator, Sparse) {
+  UpdateAccumulator accumulator;
+  accumulator.Resize(1000);
+  std::vector<float32> parameters(1000, 1.0f);
+  accumulator.Add(3, 1.0f);
+  accumulator.Add(999, 2.0f);
+  accumulator.Add(3, 3.0f);
+  EXPECT_EQ(2, accumulator.Touched());
+  accumulator.ApplyTo(parameters.data(), 0.5f);
+  for (int32 i = 0; i < 1000; ++i) {
+    float32 expected = i == 3 ? 3.0f : (i == 999 ? 2.0f : 1.0f);
+    EXPECT_EQ(expected, parameters[i]) << "at " << i;
+  }
+  // The sums are cleared for the next version.
+  EXPECT_EQ(0, accumulator.Touched());
+  accumulator.Add(4, 1.0f);
+  accumulator.ApplyTo(parameters.data(), 1.0f);
+  EXPECT_EQ(3.0f, parameters[3]);
+  EXPECT_EQ(2.0f, parameters[4]);
+}
+
+TEST(UpdateAccumulator, DenseMatchesDirectSum) {
+  const int32 kLength = 10000;
+  UpdateAccumulator accumulator;
+  accumulator.Resize(kLength);
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int32> index(0, kLength - 1);
+  // Sparse and dense versions in turn, the sums must be cleared either way.
+  for (int32 pushes : {10, 50000, 100, 20000, 1}) {
+    std::vector<float32> parameters(kLength, 0.0f), expected(kLength, 0.0f);
+    for (int32 i = 0; i < pushes; ++i) {
+      int32 k = index(random);
+      accumulator.Add(k, 1.0f);
+      expected[k] += 1.0f;
+    }
+    if (pushes >= 20000) EXPECT_EQ(kLength, accumulator.Touched());
+    accumulator.ApplyTo(parameters.data(), 0.25f);
+    for (int32 i = 0; i < kLength; ++i)
+      ASSERT_EQ(expected[i] * 0.25f, parameters[i]) << "at " << i;
+  }
+}
+
+TEST(UpdateAccumulator, Runs) {
+  const int32 kLength = 1000;
+  UpdateAccumulator accumulator;
+  accumulator.Resize(kLength);
+  std::vector<float32> values(100), parameters(kLength, 0.0f);
+  for (int32 i = 0; i < 100; ++i) values[i] = i;
+  accumulator.AddRun(10, values.data(), 100);
+  accumulator.AddRun(50, values.data(), 3);
+  EXPECT_EQ(100, accumulator.Touched());
+  accumulator.ApplyTo(parameters.data(), 1.0f);
+  for (int32 i = 0; i < kLength; ++i) {
+    float32 expected = 0.0f;
+    if (i >= 10 && i < 110) expected += i - 10;
+    if (i >= 50 && i < 53) expected += i - 50;
+    EXPECT_EQ(expected, parameters[i]) << "at " << i;
+  }
+  // A run longer than the dense threshold switches to the sweep.
+  accumulator.AddRun(0, values.data(), 100);
+  accumulator.AddRun(100, values.data(), 100);
+  EXPECT_EQ(kLength, accumulator.Touched());
+}
+
+TEST(UpdateAccumulator, MarkTouched) {
+  UpdateAccumulator accumulator;
+  accumulator.Resize(100);
+  std::vector<int32> versions(100, 0);
+  accumulator.Add(5, 1.0f);
+  accumulator.Add(70, 1.0f);
+  accumulator.MarkTouched(versions.data(), 3);
+  for (int32 i = 0; i < 100; ++i)
+    EXPECT_EQ(i == 5 || i == 70 ? 3 : 0, versions[i]) << "at " << i;
+  // A dense sweep marks every index.
+  std::vector<float32> values(100, 1.0f);
+  accumulator.AddRun(0, values.data(), 100);
+  accumulator.MarkTouched(versions.data(), 4);
+  EXPECT_EQ(std::vector<int32>(100, 4), versions);
+}
+
+TEST(UpdateAccumulator, AppendTouched) {
+  UpdateAccumulator accumulator;
+  accumulator.Resize(100);
+  accumulator.Add(70, 1.0f);
+  accumulator.Add(5, 1.0f);
+  std::vector<int32> indices = {1};
+  accumulator.AppendTouched(10, &indices);
+  EXPECT_EQ(std::vector<int32>({1, 15, 80}), indices);
+  // A dense sweep appends every index.
+  std::vector<float32> values(100, 1.0f);
+  accumulator.AddRun(0, values.data(), 100);
+  indices.clear();
+  accumulator.AppendTouched(0, &indices);
+  ASSERT_EQ(100, indices.size());
+  EXPECT_EQ(99, indices.back());
+}
+
+// A version dense enough to be swept leaves the keys it does not push as
+// they are: with momentum, key 0 moves once, by its own push.
+TEST(UpdateAccumulator, DenseKeepsUntouched) {
+  const int32 kLength = 64;
+  Message_OptimizerConfig config;
+  config.set_name("momentum");
+  config.set_learning_rate(0.1f);
+  for (int32 others : {5, 9, 40}) {
+    std::unique_ptr<Optimizer> optimizer(Optimizer::Create(config));
+    optimizer->Resize(kLength);
+    UpdateAccumulator accumulator;
+    accumulator.Resize(kLength);
+    std::vector<float32> parameters(kLength, 0.0f);
+    accumulator.Add(0, 1.0f);
+    accumulator.ApplyTo(parameters.data(), 1.0f, optimizer.get(), 1);
+    std::vector<float32> values(others, 1.0f);
+    accumulator.AddRun(kLength - others, values.data(), others);
+    accumulator.ApplyTo(parameters.data(), 1.0f, optimizer.get(), 2);
+    EXPECT_FLOAT_EQ(-0.1f, parameters[0]) << others << " other keys";
+    EXPECT_FLOAT_EQ(-0.1f, parameters[kLength - 1]) << others << " other keys";
+    EXPECT_EQ(0.0f, parameters[kLength - others - 1]) << others;
+  }
+}
+
+TEST(UpdateKernels, LevelsAgree) {
+  const int32 kSize = 1000;
+  std::vector<float32> values(kSize);
+  for (int32 i = 0; i < kSize; ++i) values[i] = i * 0.37f - 100.0f;
+  const UpdateKernels* scalar = KernelsOf(kScalar);
+  ASSERT_TRUE(scalar != NULL);
+  for (int32 level = kAvx2; level <= kAvx512; level++) {
+    const UpdateKernels* kernels = KernelsOf(static_cast<SimdLevel>(level));
+    if (kernels == NULL) continue;
+    // Odd sizes leave tails for the scalar loop.
+    for (int32 size : {0, 7, 33, kSize}) {
+      std::vector<float32> sums_a(size, 1.5f), sums_b(size, 1.5f);
+      std::vector<float32> parameters_a(size, 2.0f), parameters_b(size, 2.0f);
+      scalar->accumulate(sums_a.data(), values.data(), size);
+      kernels->accumulate(sums_b.data(), values.data(), size);
+      EXPECT_EQ(sums_a, sums_b);
+      scalar->apply(parameters_a.data(), sums_a.data(), 0.3f, size);
+      kernels->apply(parameters_b.data(), sums_b.data(), 0.3f, size);
+      for (int32 i = 0; i < size; ++i)
+        EXPECT_NEAR(parameters_a[i], parameters_b[i], 1e-5) << "at " << i;
+      EXPECT_EQ(std::vector<float32>(size, 0.0f), sums_b);
+    }
+  }
+}
@@ -0,0 +1,123 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/server/update_kernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define RPSCC_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace rpscc {
+
+namespace {
+
+void AccumulateScalar(float32* sums, const float32* values, int32 size) {
+  for (int32 i = 0; i < size; ++i) sums[i] += values[i];
+}
+
+void ApplyScalar(float32* parameters, float32* sums, float32 scale,
+                 int32 size) {
+  for (int32 i = 0; i < size; ++i) {
+    parameters[i] += sums[i] * scale;
+    sums[i] = 0.0f;
+  }
+}
+
+#ifdef RPSCC_X86_KERNELS
+
+__attribute__((target("avx2")))
+void AccumulateAvx2(float32* sums, const float32* values, int32 size) {
+  int32 i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 sum = _mm256_loadu_ps(sums + i);
+    _mm256_storeu_ps(sums + i,
+                     _mm256_add_ps(sum, _mm256_loadu_ps(values + i)));
+  }
+  AccumulateScalar(sums + i, values + i, size - i);
+}
+
+__attribute__((target("avx2")))
+void ApplyAvx2(float32* parameters, float32* sums, float32 scale,
+               int32 size) {
+  __m256 factor = _mm256_set1_ps(scale);
+  __m256 zero = _mm256_setzero_ps();
+  int32 i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 update = _mm256_mul_ps(_mm256_loadu_ps(sums + i), factor);
+    _mm256_storeu_ps(parameters + i,
+                     _mm256_add_ps(_mm256_loadu_ps(parameters + i), update));
+    _mm256_storeu_ps(sums + i, zero);
+  }
+  ApplyScalar(parameters + i, sums + i, scale, size - i);
+}
+
+__attribute__((target("avx512f")))
+void AccumulateAvx512(float32* sums, const float32* values, int32 size) {
+  int32 i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m512 sum = _mm512_loadu_ps(sums + i);
+    _mm512_storeu_ps(sums + i,
+                     _mm512_add_ps(sum, _mm512_loadu_ps(values + i)));
+  }
+  AccumulateScalar(sums + i, values + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+void ApplyAvx512(float32* parameters, float32* sums, float32 scale,
+                 int32 size) {
+  __m512 factor = _mm512_set1_ps(scale);
+  __m512 zero = _mm512_setzero_ps();
+  int32 i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m512 update = _mm512_mul_ps(_mm512_loadu_ps(sums + i), factor);
+    _mm512_storeu_ps(parameters + i,
+                     _mm512_add_ps(_mm512_loadu_ps(parameters + i), update));
+    _mm512_storeu_ps(sums + i, zero);
+  }
+  ApplyScalar(parameters + i, sums + i, scale, size - i);
+}
+
+#endif  // RPSCC_X86_KERNELS
+
+const UpdateKernels kScalarKernels = {AccumulateScalar, ApplyScalar};
+#ifdef RPSCC_X86_KERNELS
+const UpdateKernels kAvx2Kernels = {AccumulateAvx2, ApplyAvx2};
+const UpdateKernels kAvx512Kernels = {AccumulateAvx512, ApplyAvx512};
+#endif
+
+}  // namespace
+
+SimdLevel BestSimdLevel() {
+#ifdef RPSCC_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return kAvx512;
+  if (__builtin_cpu_supports("avx2")) return kAvx2;
+#endif
+  return kScalar;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+  switch (level) {
+    case kAvx2: return "avx2";
+    case kAvx512: return "avx512";
+    default: return "scalar";
+  }
+}
+
+const UpdateKernels* KernelsOf(SimdLevel level) {
+  if (level > BestSimdLevel()) return NULL;
+  switch (level) {
+#ifdef RPSCC_X86_KERNELS
+    case kAvx2: return &kAvx2Kernels;
+    case kAvx512: return &kAvx512Kernels;
+#endif
+    default: return &kScalarKernels;
+  }
+}
+
+const UpdateKernels& Kernels() {
+  static const UpdateKernels* kernels = KernelsOf(BestSimdLevel());
+  return *kernels;
+}
+
+}  // namespace rpscc
@@ -0,0 +1,41 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+#ifndef SRC_SERVER_UPDATE_KERNELS_H_
+#define SRC_SERVER_UPDATE_KERNELS_H_
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// Loops over contiguous float arrays which the server runs when it applies
+// updates. Besides the scalar loops there are AVX2 and AVX-512 versions,
+// compiled for their targets on x86 and picked at runtime by what the CPU
+// supports, so the binary still runs on older CPUs. The compiler may fuse
+// the multiply-add of apply where the target has FMA, so results of the
+// levels can differ in the last bit.
+enum SimdLevel {
+  kScalar = 0,
+  kAvx2 = 1,
+  kAvx512 = 2,
+};
+
+struct UpdateKernels {
+  // sums[i] += values[i]
+  void (*accumulate)(float32* sums, const float32* values, int32 size);
+  // parameters[i] += sums[i] * scale, and then sums[i] = 0
+  void (*apply)(float32* parameters, float32* sums, float32 scale,
+                int32 size);
+};
+
+// The best level supported by the CPU and the compiler.
+SimdLevel BestSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+// The kernels of level, or NULL if the CPU or the compiler lacks it.
+const UpdateKernels* KernelsOf(SimdLevel level);
+
+// The kernels of the best level, picked at the first call.
+const UpdateKernels& Kernels();
+
+}  // namespace rpscc
+
+#endif  // SRC_SERVER_UPDATE_KERNELS_H_
@@ -0,0 +1,71 @@
+// Copyright (c) 2019 The RPSCC Authors. All rights reserved.
+//
+// Benchmark for the update kernels of the server on one core. For every
+// SIMD level the CPU supports, the accumulate and apply kernels run over
+// arrays of n floats, and the bandwidth is reported counting every byte
+// read and written: 12 bytes per float for accumulate, 16 for apply.
+//
+// Usage: ./update_kernels_benchmark --sizes=4096,1048576,67108864
+
+#include <stdio.h>
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "src/server/update_kernels.h"
+
+DEFINE_string(sizes, "4096,262144,16777216",
+              "Comma separated lengths of the arrays.");
+DEFINE_double(seconds, 0.5, "Time spent on each kernel and size.");
+
+using namespace rpscc;
+
+namespace {
+
+// Return the bytes per second of calling function, which moves bytes.
+template <typename Function>
+double Measure(double bytes, const Function& function) {
+  int64 calls = 0;
+  double seconds = 0;
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  while (seconds < FLAGS_seconds) {
+    function();
+    calls++;
+    seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+  }
+  return bytes * calls / seconds;
+}
+
+void Run(int32 size) {
+  std::vector<float32> parameters(size, 1.0f), sums(size, 0.0f);
+  std::vector<float32> values(size, 0.5f);
+  for (int32 level = kScalar; level <= kAvx512; level++) {
+    const UpdateKernels* kernels = KernelsOf(static_cast<SimdLevel>(level));
+    if (kernels == NULL) continue;
+    double accumulate = Measure(12.0 * size, [&] {
+      kernels->accumulate(sums.data(), values.data(), size);
+    });
+    double apply = Measure(16.0 * size, [&] {
+      kernels->apply(parameters.data(), sums.data(), 0.5f, size);
+    });
+    printf("size = %-10d %-7s accumulate %7.2f GB/s, apply %7.2f GB/s\n",
+           size, SimdLevelName(static_cast<SimdLevel>(level)),
+           accumulate / 1e9, apply / 1e9);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  printf("Best SIMD level: %s\n", SimdLevelName(BestSimdLevel()));
+  std::stringstream sizes(FLAGS_sizes);
+  std::string size;
+  while (std::getline(sizes, size, ',')) Run(std::stoi(size));
+  return 0;
+}
@@ -0,0 +1,56 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include "src/util/thread_pool.h"
+
+#include <utility>
+
+namespace rpscc {
+
+ThreadPool::ThreadPool(int32 threads) : pending_(0), stop_(false) {
+  for (int32 i = 0; i < threads; i++)
+    workers_.emplace_back(&ThreadPool::Work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  task_cond_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  if (workers_.empty()) {
+    task();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+    pending_++;
+  }
+  task_cond_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cond_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    task_cond_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+    if (tasks_.empty()) return;
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+    if (--pending_ == 0) done_cond_.notify_all();
+  }
+}
+
+}  // namespace rpscc
@@ -0,0 +1,48 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#ifndef SRC_UTIL_THREAD_POOL_H_
+#define SRC_UTIL_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/util/common.h"
+
+namespace rpscc {
+
+// ThreadPool runs tasks on a fixed set of threads. A caller schedules a batch
+// of tasks and then waits for all of them, e.g. the agent serializes the
+// requests to every server in parallel. A pool of 0 threads runs each task in
+// Schedule, in the caller's thread.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int32 threads);
+  // Wait for the scheduled tasks, and stop the threads.
+  ~ThreadPool();
+
+  void Schedule(std::function<void()> task);
+  // Block until every task scheduled so far has finished.
+  void Wait();
+
+  int32 size() const { return workers_.size(); }
+
+ private:
+  void Work();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  // Number of tasks scheduled but not finished.
+  int32 pending_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable task_cond_;
+  std::condition_variable done_cond_;
+};
+
+}  // namespace rpscc
+
+#endif  // SRC_UTIL_THREAD_POOL_H_
@@ -0,0 +1,39 @@
+// Copyright 2018 The RPSCC Authors. All Rights Reserved.
+
+#include <atomic>
+#include <vector>
+
+#include "src/util/thread_pool.h"
+#include "gtest/gtest.h"
+
+using namespace rpscc;
+
+TEST(ThreadPool, RunsEveryTask) {
+  for (int32 threads : {0, 1, 4}) {
+    ThreadPool pool(threads);
+    EXPECT_EQ(threads, pool.size());
+    std::vector<int32> done(1000, 0);
+    for (int32 i = 0; i < 1000; i++) pool.Schedule([&done, i] { done[i]++; });
+    pool.Wait();
+    for (int32 i = 0; i < 1000; i++) EXPECT_EQ(1, done[i]);
+  }
+}
+
+TEST(ThreadPool, WaitBetweenBatches) {
+  ThreadPool pool(3);
+  std::atomic<int32> count(0);
+  for (int32 batch = 1; batch <= 10; batch++) {
+    for (int32 i = 0; i < 100; i++) pool.Schedule([&count] { count++; });
+    pool.Wait();
+    EXPECT_EQ(batch * 100, count.load());
+  }
+}
+
+TEST(ThreadPool, DestructorWaits) {
+  std::atomic<int32> count(0);
+  {
+    ThreadPool pool(2);
+    for (int32 i = 0; i < 100; i++) pool.Schedule([&count] { count++; });
+  }
+  EXPECT_EQ(100, count.load());
+}